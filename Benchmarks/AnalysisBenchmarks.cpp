@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    AnalysisBenchmarks.cpp
+
+    Offline analysis stages. Each stage is run once on its own thread to
+    produce its input, then benchmarked by calling run() directly.
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "BenchmarkUtils.h"
+#include "DSP/Fft.h"
+#include "DSP/PitchDetector.h"
+#include "DSP/TransientDetector.h"
+
+static constexpr auto ANALYSIS_TIMEOUT_MS = 60 * 1000;
+
+TEST_CASE("Fft::run", "[analysis]") {
+  const juce::AudioBuffer<float> audio = BenchmarkUtils::makeTestAudio();
+  // The single pass every analysis stage shares
+  Fft fft(PitchDetector::FFT_SIZE, PitchDetector::HOP_SIZE, 0.0, 1.0);
+  fft.process(&audio);
+  REQUIRE(fft.waitForThreadToExit(ANALYSIS_TIMEOUT_MS));
+
+  BENCHMARK("fft " + std::to_string(PitchDetector::FFT_SIZE) + " hop " + std::to_string(PitchDetector::HOP_SIZE)) {
+    fft.run();
+    return fft.getSpectrum().size();
+  };
+}
+
+TEST_CASE("PitchDetector::run", "[analysis]") {
+  const juce::AudioBuffer<float> audio = BenchmarkUtils::makeTestAudio();
+  PitchDetector pitchDetector(0.0, 1.0);
+  juce::WaitableEvent pitchesReady;
+  pitchDetector.onPitchesReady = [&pitchesReady](PitchDetector::PitchMap&, Utils::SpecBuffer&) { pitchesReady.signal(); };
+  pitchDetector.process(&audio, BenchmarkUtils::SAMPLE_RATE);
+  REQUIRE(pitchesReady.wait(ANALYSIS_TIMEOUT_MS));
+  pitchDetector.onPitchesReady = nullptr;
+
+  // computeHPCP and segmentPitches over the spectrum kept from the first pass
+  BENCHMARK("hpcp + segment pitches") { pitchDetector.run(); };
+}
+
+TEST_CASE("TransientDetector::run", "[analysis]") {
+  const juce::AudioBuffer<float> audio = BenchmarkUtils::makeTestAudio();
+  Fft fft(PitchDetector::FFT_SIZE, PitchDetector::HOP_SIZE, 0.0, 1.0);
+  fft.process(&audio);
+  REQUIRE(fft.waitForThreadToExit(ANALYSIS_TIMEOUT_MS));
+
+  TransientDetector transientDetector(0.0, 1.0);
+  juce::WaitableEvent transientsReady;
+  size_t numTransients = 0;
+  transientDetector.onTransientsUpdated = [&](std::vector<TransientDetector::Transient>& transients) {
+    numTransients = transients.size();
+    transientsReady.signal();
+  };
+  transientDetector.process(&fft.getSpectrum());
+  REQUIRE(transientsReady.wait(ANALYSIS_TIMEOUT_MS));
+  CHECK(numTransients > 0);
+
+  // retrieveTransients over the spectrum kept from the first pass
+  BENCHMARK("retrieve transients") {
+    transientDetector.run();
+    return numTransients;
+  };
+}
@@ -0,0 +1,41 @@
+/*
+  ==============================================================================
+
+    BenchmarkUtils.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace BenchmarkUtils {
+static constexpr auto SAMPLE_RATE = 48000.0;
+static constexpr auto AUDIO_LENGTH_SEC = 8.0;
+
+// Deterministic stand in for a loaded file. Steps through a chromatic run of harmonic tones so the pitch detector finds a
+// candidate for every pitch class, with a short attack on each step for the transient detector.
+static juce::AudioBuffer<float> makeTestAudio(double sampleRate = SAMPLE_RATE, double lengthSec = AUDIO_LENGTH_SEC) {
+  static constexpr auto NUM_STEPS = 24;
+  static constexpr auto NUM_HARMONICS = 4;
+  const int numSamples = static_cast<int>(sampleRate * lengthSec);
+  const int stepSamples = numSamples / NUM_STEPS;
+  juce::AudioBuffer<float> buffer(2, numSamples);
+  for (int i = 0; i < numSamples; ++i) {
+    const int step = i / stepSamples;
+    const int stepPos = i % stepSamples;
+    const double freq = juce::MidiMessage::getMidiNoteInHertz(48 + (step % 12) + 12 * (step / 12));
+    const double t = i / sampleRate;
+    float sample = 0.0f;
+    for (int h = 1; h <= NUM_HARMONICS; ++h) {
+      sample += std::sin(juce::MathConstants<double>::twoPi * freq * h * t) / h;
+    }
+    const float attack = juce::jmin(1.0f, stepPos / (0.005f * (float)sampleRate));
+    const float decay = 1.0f - 0.5f * (stepPos / (float)stepSamples);
+    buffer.setSample(0, i, 0.25f * sample * attack * decay);
+  }
+  buffer.copyFrom(1, 0, buffer, 0, 0, numSamples);
+  return buffer;
+}
+}  // namespace BenchmarkUtils
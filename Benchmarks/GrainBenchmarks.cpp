@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    GrainBenchmarks.cpp
+
+    GrainBank::process on its own with every grain slot in use, the inner
+    loop processBlock spends most of its time in. ns/sample is the reported
+    mean / BLOCK_SIZE.
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include "BenchmarkUtils.h"
+#include "DSP/Grain.h"
+#include "Parameters.h"
+
+static constexpr auto BLOCK_SIZE = 512;
+static constexpr auto ENV_SIZE = 512;
+static constexpr auto NUM_BANKS = 12;  // A full generator on each of 12 voices, 240 grains per block
+
+namespace {
+std::vector<float> makeEnvelope() {
+  std::vector<float> env(ENV_SIZE);
+  for (int i = 0; i < ENV_SIZE; ++i) {
+    env[i] = std::sin(juce::MathConstants<float>::pi * i / (ENV_SIZE - 1));
+  }
+  return env;
+}
+
+// Refills finished grains so every block mixes a full bank, with rates spread across the sinc bands
+void fillBank(GrainBank& bank, const std::vector<float>& env, int fileNumSamples, juce::Random& random) {
+  while (!bank.isFull()) {
+    const int duration = static_cast<int>(BenchmarkUtils::SAMPLE_RATE * (0.1f + 0.1f * random.nextFloat()));
+    const float pbRate = 0.5f + 1.5f * random.nextFloat();
+    bank.add(env.data(), ENV_SIZE, duration, pbRate, random.nextInt(fileNumSamples), fileNumSamples,
+             random.nextFloat() * 2.0f - 1.0f);
+  }
+}
+}  // namespace
+
+TEST_CASE("GrainBank::process", "[grain]") {
+  const auto interpolation = static_cast<Utils::InterpolationType>(
+      GENERATE((int)Utils::InterpolationType::LINEAR, (int)Utils::InterpolationType::HERMITE, (int)Utils::InterpolationType::SINC));
+  const int numChannels = GENERATE(1, 2);
+
+  juce::AudioBuffer<float> audio = BenchmarkUtils::makeTestAudio();
+  audio.setSize(numChannels, audio.getNumSamples(), true);
+  const std::vector<float> env = makeEnvelope();
+  juce::AudioBuffer<float> out(2, BLOCK_SIZE);
+  GrainBank bank;
+  juce::Random random(1);
+
+  const juce::String name = juce::String::formatted("grains %d channels %d interp %s", GrainBank::MAX_GRAINS, numChannels,
+                                                    INTERPOLATION_NAMES[interpolation].toRawUTF8());
+  BENCHMARK(name.toStdString()) {
+    fillBank(bank, env, audio.getNumSamples(), random);
+    out.clear();
+    bank.process(audio, out.getWritePointer(0), out.getWritePointer(1), BLOCK_SIZE, interpolation);
+    bank.removeFinished();
+    return out.getSample(0, 0);
+  };
+}
+
+// Many banks reading from all over the file, closer to the working set of a full processBlock than a single bank
+TEST_CASE("GrainBank::process many banks", "[grain]") {
+  const auto interpolation = static_cast<Utils::InterpolationType>(
+      GENERATE((int)Utils::InterpolationType::LINEAR, (int)Utils::InterpolationType::HERMITE, (int)Utils::InterpolationType::SINC));
+  const int numChannels = GENERATE(1, 2);
+
+  juce::AudioBuffer<float> audio = BenchmarkUtils::makeTestAudio();
+  audio.setSize(numChannels, audio.getNumSamples(), true);
+  const std::vector<float> env = makeEnvelope();
+  juce::AudioBuffer<float> out(2, BLOCK_SIZE);
+  std::array<GrainBank, NUM_BANKS> banks;
+  juce::Random random(1);
+
+  const juce::String name = juce::String::formatted("grains %d channels %d interp %s", NUM_BANKS * GrainBank::MAX_GRAINS,
+                                                    numChannels, INTERPOLATION_NAMES[interpolation].toRawUTF8());
+  BENCHMARK(name.toStdString()) {
+    out.clear();
+    for (GrainBank& bank : banks) {
+      fillBank(bank, env, audio.getNumSamples(), random);
+      bank.process(audio, out.getWritePointer(0), out.getWritePointer(1), BLOCK_SIZE, interpolation);
+      bank.removeFinished();
+    }
+    return out.getSample(0, 0);
+  };
+}
@@ -0,0 +1,21 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    Entry point for the benchmark suite. Catch2's own main can't be used
+    because the synth parameters need a message manager on this thread.
+
+    Results are meant to be tracked across commits, run with the XML reporter:
+      ./Benchmarks --reporter XML::out=benchmarks.xml
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_session.hpp>
+#include <juce_events/juce_events.h>
+
+int main(int argc, char* argv[]) {
+  juce::ScopedJuceInitialiser_GUI juceInitialiser;
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,142 @@
+/*
+  ==============================================================================
+
+    SynthBenchmarks.cpp
+
+    GranularSynth::processBlock over the parameter space that drives its cost.
+    Every benchmark iteration renders RENDER_SAMPLES samples no matter the
+    block size, so ns/sample is the reported mean / RENDER_SAMPLES and results
+    are comparable between configurations.
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include "BenchmarkUtils.h"
+#include "DSP/GranularSynth.h"
+
+static constexpr auto RENDER_SAMPLES = 4096;
+static constexpr auto SETTLE_SEC = 0.5;  // Long enough for grains to fill up after note on and to die out after note off
+static constexpr auto BASE_MIDI_NOTE = 60;
+static constexpr auto ANALYSIS_TIMEOUT_MS = 60 * 1000;
+
+struct SynthConfig {
+  int numNotes = 8;
+  int numGenerators = NUM_GENERATORS;
+  int blockSize = 512;
+  float grainRate = ParamDefaults::GRAIN_RATE_DEFAULT;
+  float grainDuration = ParamDefaults::GRAIN_DURATION_DEFAULT;
+  int filterType = 0;  // index into FILTER_TYPE_NAMES
+  Utils::InterpolationType interpolation = Utils::InterpolationType::LINEAR;
+
+  std::string getName() const {
+    return juce::String::formatted("notes %d gens %d block %d rate %.2f dur %.2f filt %s interp %s", numNotes, numGenerators,
+                                   blockSize, grainRate, grainDuration, FILTER_TYPE_NAMES[filterType].toRawUTF8(),
+                                   INTERPOLATION_NAMES[interpolation].toRawUTF8())
+        .toStdString();
+  }
+};
+
+// Analysis takes seconds, so a single synth is loaded once and reconfigured for each benchmark
+static GranularSynth& getLoadedSynth() {
+  static std::unique_ptr<GranularSynth> synth;
+  if (synth == nullptr) {
+    synth = std::make_unique<GranularSynth>();
+    synth->setPlayConfigDetails(0, 2, BenchmarkUtils::SAMPLE_RATE, 512);
+    synth->prepareToPlay(BenchmarkUtils::SAMPLE_RATE, 512);
+    juce::AudioBuffer<float> audio = BenchmarkUtils::makeTestAudio();
+    synth->setInputBuffer(&audio, BenchmarkUtils::SAMPLE_RATE);
+    synth->processInput(juce::Range<juce::int64>(), false);
+    const juce::uint32 startMs = juce::Time::getMillisecondCounter();
+    while (synth->getLoadingProgress() < 1.0 && juce::Time::getMillisecondCounter() - startMs < ANALYSIS_TIMEOUT_MS) {
+      juce::Thread::sleep(10);
+    }
+
+    // Make sure every generator has something to play even if detection came up short for a pitch class
+    for (auto& note : synth->getParamsNote().notes) {
+      for (int i = (int)note->candidates.size(); i < NUM_GENERATORS; ++i) {
+        note->candidates.push_back(ParamCandidate((i + 0.5f) / NUM_GENERATORS, 1.0f, 0.1f, 1.0f));
+      }
+      for (auto& gen : note->generators) {
+        ParamHelper::setParam(gen->candidate, gen->genIdx);
+      }
+    }
+    synth->publishCandidates();
+  }
+  return *synth;
+}
+
+static void renderSamples(GranularSynth& synth, juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi, int numSamples) {
+  for (int i = 0; i < numSamples; i += buffer.getNumSamples()) {
+    synth.processBlock(buffer, midi);
+    midi.clear();
+  }
+}
+
+static void benchmarkProcessBlock(const SynthConfig& config) {
+  GranularSynth& synth = getLoadedSynth();
+  REQUIRE(synth.getLoadingProgress() == 1.0);
+
+  ParamGlobal& global = synth.getParamGlobal();
+  ParamHelper::setParam(P_FLOAT(global.common[ParamCommon::Type::GRAIN_RATE]), config.grainRate);
+  ParamHelper::setParam(P_FLOAT(global.common[ParamCommon::Type::GRAIN_DURATION]), config.grainDuration);
+  ParamHelper::setParam(P_CHOICE(global.common[ParamCommon::Type::FILT_TYPE]), config.filterType);
+  ParamHelper::setParam(global.interpolation, (int)config.interpolation);
+  for (auto& note : synth.getParamsNote().notes) {
+    for (auto& gen : note->generators) {
+      ParamHelper::setParam(gen->enable, gen->genIdx < config.numGenerators);
+    }
+  }
+  synth.prepareToPlay(BenchmarkUtils::SAMPLE_RATE, config.blockSize);
+
+  juce::AudioBuffer<float> buffer(2, config.blockSize);
+  juce::MidiBuffer midi;
+  for (int i = 0; i < config.numNotes; ++i) {
+    midi.addEvent(juce::MidiMessage::noteOn(1, BASE_MIDI_NOTE + i, 1.0f), 0);
+  }
+  // Only measure the steady state of held notes
+  renderSamples(synth, buffer, midi, static_cast<int>(SETTLE_SEC * BenchmarkUtils::SAMPLE_RATE));
+
+  BENCHMARK(config.getName()) {
+    renderSamples(synth, buffer, midi, RENDER_SAMPLES);
+    return buffer.getSample(0, 0);
+  };
+
+  for (int i = 0; i < config.numNotes; ++i) {
+    midi.addEvent(juce::MidiMessage::noteOff(1, BASE_MIDI_NOTE + i), 0);
+  }
+  const double releaseSec = SETTLE_SEC + ParamDefaults::RELEASE_DEFAULT_SEC;
+  renderSamples(synth, buffer, midi, static_cast<int>(releaseSec * BenchmarkUtils::SAMPLE_RATE));
+}
+
+TEST_CASE("processBlock polyphony x generators x block size", "[synth]") {
+  SynthConfig config;
+  config.numNotes = GENERATE(1, 4, 8, 12);
+  config.numGenerators = GENERATE(1, 2, 4);
+  config.blockSize = GENERATE(16, 64, 256, 512, 2048);
+  benchmarkProcessBlock(config);
+}
+
+TEST_CASE("processBlock grain density", "[synth]") {
+  // Extremes of both, the shortest trigger interval with the longest grains keeps the most grains alive at once
+  SynthConfig config;
+  config.grainRate = GENERATE(ParamRanges::GRAIN_RATE.start, ParamRanges::GRAIN_RATE.end);
+  config.grainDuration = GENERATE(ParamRanges::GRAIN_DURATION.start, ParamRanges::GRAIN_DURATION.end);
+  benchmarkProcessBlock(config);
+}
+
+TEST_CASE("processBlock filter type", "[synth]") {
+  SynthConfig config;
+  config.filterType = GENERATE(range(0, FILTER_TYPE_NAMES.size()));
+  benchmarkProcessBlock(config);
+}
+
+TEST_CASE("processBlock interpolation", "[synth]") {
+  SynthConfig config;
+  config.interpolation = static_cast<Utils::InterpolationType>(
+      GENERATE((int)Utils::InterpolationType::LINEAR, (int)Utils::InterpolationType::HERMITE, (int)Utils::InterpolationType::SINC));
+  benchmarkProcessBlock(config);
+}
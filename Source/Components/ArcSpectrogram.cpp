@@ -15,18 +15,19 @@
 #include "Settings.h"
 
 //==============================================================================
-ArcSpectrogram::ArcSpectrogram(ParamsNote& paramsNote, ParamUI& paramUI)
-    : mParamsNote(paramsNote), mParamUI(paramUI), juce::Thread("spectrogram thread") {
-  setFramesPerSecond(REFRESH_RATE_FPS);
+ArcSpectrogram::ArcSpectrogram(ParamsNote& paramsNote, ParamUI& paramUI, GrainEventFifo& grainEvents)
+    : mParamsNote(paramsNote),
+      mParamUI(paramUI),
+      mGrainEvents(grainEvents),
+      mImagePool(juce::jmax(1, juce::SystemStats::getNumCpus())) {
   mBuffers.fill(nullptr);
 
   // check if params has images, which would mean the plugin was reopened
-  if (!mParamUI.specComplete) {
-    // if not complete, we assume all images will be remade, no "half way"
-    // support currently
-    for (int i = 0; i < (int)ParamUI::SpecType::COUNT; i++) {
-      mImagesComplete[(ParamUI::SpecType)i] = false;
-    }
+  // if not complete, we assume all images will be remade, no "half way"
+  // support currently
+  if (mParamUI.specComplete) {
+    mImagesStarted = ALL_IMAGES;
+    mImagesComplete = ALL_IMAGES;
   }
 
   // ComboBox for some reason is not zero indexed like the rest of JUCE and C++
@@ -40,89 +41,146 @@ ArcSpectrogram::ArcSpectrogram(ParamsNote& paramsNote, ParamUI& paramUI)
     // Will get called from user using UI ComboBox and from inside this class
     // when loading buffers
     mParamUI.specType = (ParamUI::SpecType)mSpecType.getSelectedItemIndex();
-    repaint();
+    invalidateBackground();
   };
   mSpecType.setTooltip("Change Spectrogram type to view");
+  for (int i = 0; i < (int)ParamUI::SpecType::COUNT; i++) {
+    mSpecType.setItemEnabled(i + 1, mParamUI.specComplete);
+  }
   mSpecType.setVisible(true);
 
   mActivePitchClass.reset(false);
 
-  mParamsNote.onGrainCreated = [this](Utils::PitchClass pitchClass, int genIdx, float durationSec, float envGain) {
-    // always get the callback, but ignore it if note was released or over grain max
-    if (!mActivePitchClass[pitchClass] || mArcGrains.size() >= MAX_NUM_GRAINS) {
-      return;
-    }
-    ParamGenerator* gen = mParamsNote.notes[pitchClass]->generators[genIdx].get();
-    float envIncSamples = ENV_LUT_SIZE / (durationSec * REFRESH_RATE_FPS);
-    mArcGrains.add(ArcGrain(gen, envGain, envIncSamples, pitchClass));
-  };
+  for (int i = 0; i < HUE_TABLE_SIZE; ++i) {
+    mHueTable[i] = juce::Colour::fromHSV(i / (float)(HUE_TABLE_SIZE - 1), 1.0f, 1.0f, 1.0f).getPixelARGB();
+  }
+
+  // Grains spawned while no editor was open are long gone
+  mGrainEvents.drain([](const GrainEvent&) {});
 
   addChildComponent(mSpecType);
+  startTimerHz(REFRESH_RATE_FPS);
 }
 
 ArcSpectrogram::~ArcSpectrogram() {
-  mParamsNote.onGrainCreated = nullptr;
-  stopThread(4000);
+  mGeneration++;
+  mImagePool.removeAllJobs(true, BUFFER_PROCESS_TIMEOUT);
+  // A job setting up a level may have queued its tiles while the first call waited on it
+  mImagePool.removeAllJobs(true, BUFFER_PROCESS_TIMEOUT);
+}
+
+void ArcSpectrogram::timerCallback() {
+  // The background only has to follow a level while it is being drawn
+  if (isLevelInProgress()) invalidateBackground();
+
+  // Grains spawned on the audio thread since the last frame
+  mGrainEvents.drain([this](const GrainEvent& event) { addGrain(event); });
+
+  // Remove arc grains that are completed, along with what they last drew
+  mArcGrains.removeIf([this](ArcGrain& grain) {
+    if ((grain.numFramesActive * grain.envIncSamples) <= ENV_LUT_SIZE) return false;
+    repaint(getGrainBounds(grain));
+    return true;
+  });
+
+  // Only the boxes of the grains are repainted, where they were and where they are now
+  const bool isAnimated = PowerUserSettings::get().getAnimated();
+  for (ArcGrain& grain : mArcGrains) {
+    const juce::Rectangle<int> lastBounds = getGrainBounds(grain);
+    // still increment frames if not animating
+    grain.rect = isAnimated ? getGrainRect(grain) : juce::Rectangle<float>();
+    grain.numFramesActive++;
+    const juce::Rectangle<int> bounds = getGrainBounds(grain);
+    if (!lastBounds.isEmpty()) repaint(bounds.isEmpty() ? lastBounds : lastBounds.getUnion(bounds));
+    else if (!bounds.isEmpty()) repaint(bounds);
+  }
+}
+
+void ArcSpectrogram::addGrain(const GrainEvent& event) {
+  // always get the event, but ignore it if note was released
+  if (!mActivePitchClass[event.pitchClass]) return;
+  ParamGenerator* gen = mParamsNote.notes[event.pitchClass]->generators[event.genIdx].get();
+  float envIncSamples = ENV_LUT_SIZE / (event.durationSec * REFRESH_RATE_FPS);
+  float posRatio = event.posRatio + (event.duration * event.posAdjust);
+  float posTravel = event.duration / event.pbRate;
+  float grainPitch = event.pitchClass - (std::log(event.pbRate) / std::log(Utils::TIMESTRETCH_RATIO));
+  float radiusRatio = (grainPitch + 0.25f + (event.pitchAdjust * 6.0f)) / (float)Utils::PitchClass::COUNT;
+  mArcGrains.add(ArcGrain(gen, event.envGain, envIncSamples, posRatio, posTravel, radiusRatio,
+                          Utils::getRainbow12Colour(event.pitchClass)));
+}
+
+juce::Rectangle<float> ArcSpectrogram::getGrainRect(const ArcGrain& grain) const {
+  float grainProg = (grain.numFramesActive * grain.envIncSamples) / ENV_LUT_SIZE;
+  float xRatio = getArcRatio(grain.posRatio + grain.posTravel * grainProg);
+  // Zoomed out of view
+  if (xRatio < 0.0f || xRatio > 1.0f) return {};
+  float grainRad = mStartRadius + (grain.radiusRatio * mBowWidth);
+  juce::Point<float> grainPoint = mCenterPoint.getPointOnCircumference(
+      grainRad, (1.5f * juce::MathConstants<float>::pi) + (xRatio * juce::MathConstants<float>::pi));
+  float envIdx = juce::jmin(ENV_LUT_SIZE - 1.0f, grain.numFramesActive * grain.envIncSamples);
+  float grainSize = grain.gain * grain.paramGenerator->grainEnv.load()[(int)envIdx] * MAX_GRAIN_SIZE;
+  return juce::Rectangle<float>(grainSize, grainSize).withCentre(grainPoint);
 }
 
 void ArcSpectrogram::paint(juce::Graphics& g) {
-  g.fillAll(juce::Colours::black);
+  const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+  const int width = juce::roundToInt(getWidth() * scale);
+  const int height = juce::roundToInt(getHeight() * scale);
+  if (mIsBackgroundDirty || mBackground.getWidth() != width || mBackground.getHeight() != height) {
+    drawBackground(scale);
+  }
+  g.drawImage(mBackground, getLocalBounds().toFloat(), juce::RectanglePlacement::stretchToFit);
 
-  // if nothing has been loaded skip image, progress bar will fill in void space
-  if (mParamUI.specType != ParamUI::SpecType::INVALID) {
-    int imageIndex = mSpecType.getSelectedItemIndex();
-    // When loading up a plugin a second time, need to set the ComboBox state,
-    // but can't in the constructor so there is the first spot we can enforce
-    // it. Without this, the logo will appear when reopening the plugin
-    if (imageIndex == -1) {
-      mSpecType.setSelectedItemIndex(mParamUI.specType, juce::dontSendNotification);
-      imageIndex = (int)mParamUI.specType;
-    }
-    g.drawImage(mParamUI.specImages[imageIndex], getLocalBounds().toFloat(),
-                juce::RectanglePlacement(juce::RectanglePlacement::fillDestination), false);
+  // Draw active grains, only the ones in the area being repainted
+  for (const ArcGrain& grain : mArcGrains) {
+    if (grain.rect.isEmpty() || !g.clipRegionIntersects(getGrainBounds(grain))) continue;
+    g.setColour(grain.colour);
+    g.drawEllipse(grain.rect, GRAIN_LINE_WIDTH);
   }
+}
 
-  // Draw active grains
-  if (PowerUserSettings::get().getAnimated()) {
-    for (ArcGrain& grain : mArcGrains) {
-      const int noteIdx = grain.paramGenerator->noteIdx;
-      const int genIdx = grain.paramGenerator->genIdx;
-      const ParamCandidate* candidate = mParamsNote.notes[noteIdx]->getCandidate(genIdx);
-      // candidates are updated when a new sampler is created, there is a chance we are still playing the old sample in which case
-      // just end drawing
-      if (candidate == nullptr) {
-        return;
-      }
+void ArcSpectrogram::drawBackground(float scale) {
+  mIsBackgroundDirty = false;
+  mBackground = juce::Image(juce::Image::RGB, juce::jmax(1, juce::roundToInt(getWidth() * scale)),
+                            juce::jmax(1, juce::roundToInt(getHeight() * scale)), false);
+  juce::Graphics g(mBackground);
+  g.addTransform(juce::AffineTransform::scale(scale));
+  g.fillAll(juce::Colours::black);
 
-      float xRatio = candidate->posRatio + (candidate->duration * P_FLOAT(grain.paramGenerator->common[ParamCommon::Type::POS_ADJUST])->get());
-      float grainProg = (grain.numFramesActive * grain.envIncSamples) / ENV_LUT_SIZE;
-      xRatio += (candidate->duration / candidate->pbRate) * grainProg;
-      float pitchClass = noteIdx - (std::log(candidate->pbRate) / std::log(Utils::TIMESTRETCH_RATIO));
-      float yRatio = (pitchClass + 0.25f + (P_FLOAT(grain.paramGenerator->common[ParamCommon::Type::PITCH_ADJUST])->get() * 6.0f)) /
-                     (float)Utils::PitchClass::COUNT;
-      int grainRad = mStartRadius + (yRatio * mBowWidth);
-      juce::Point<float> grainPoint = mCenterPoint.getPointOnCircumference(
-          grainRad, (1.5f * juce::MathConstants<float>::pi) + (xRatio * juce::MathConstants<float>::pi));
-      float envIdx = juce::jmin(ENV_LUT_SIZE - 1.0f, grain.numFramesActive * grain.envIncSamples);
-      float grainSize = grain.gain * grain.paramGenerator->grainEnvLUT[envIdx] * MAX_GRAIN_SIZE;
-
-      juce::Rectangle<float> grainRect = juce::Rectangle<float>(grainSize, grainSize).withCentre(grainPoint);
-      juce::Colour pitchColour = Utils::getRainbow12Colour(grain.pitchClass);
-      g.setColour(pitchColour);
-      g.drawEllipse(grainRect, 2.0f);
-
-      grain.numFramesActive++;
-    }
+  // if nothing has been loaded skip image, progress bar will fill in void space
+  if (mParamUI.specType == ParamUI::SpecType::INVALID) return;
+  int imageIndex = mSpecType.getSelectedItemIndex();
+  // When loading up a plugin a second time, need to set the ComboBox state,
+  // but can't in the constructor so there is the first spot we can enforce
+  // it. Without this, the logo will appear when reopening the plugin
+  if (imageIndex == -1) {
+    mSpecType.setSelectedItemIndex(mParamUI.specType, juce::dontSendNotification);
+    imageIndex = (int)mParamUI.specType;
+  }
+  const ParamUI::SpecType type = (ParamUI::SpecType)imageIndex;
+  const int wantedLevel = getWantedLevel();
+  // Once a view is done, other sizes are only drawn when asked for
+  if (isImageComplete(type) && canDrawLevels(type) && !(mLevelsStarted[type] & (1u << wantedLevel))) {
+    startLevel(type, wantedLevel);
+  }
+  const int level = findLevelToDraw(type, wantedLevel);
+  g.setImageResamplingQuality(juce::Graphics::highResamplingQuality);
+  if (level >= 0) {
+    g.drawImage(mLevels[type][level], getArcBounds(), juce::RectanglePlacement::stretchToFit);
+  } else if (mParamUI.specImages[type].getWidth() == mParamUI.specImages[type].getHeight() * 2) {
+    // From a preset, a level image of the whole half disc
+    g.drawImage(mParamUI.specImages[type], getArcBounds(), juce::RectanglePlacement::stretchToFit);
   } else {
-    // still increment frames if not animating
-    for (ArcGrain& grain : mArcGrains) {
-      grain.numFramesActive++;
-    }
+    // From a preset saved before the images were levels, sized like the component was
+    g.drawImage(mParamUI.specImages[type], getLocalBounds().toFloat(),
+                juce::RectanglePlacement(juce::RectanglePlacement::fillDestination), false);
   }
+}
 
-  // Remove arc grains that are completed
-  mArcGrains.removeIf(
-      [this](ArcGrain& grain) { return (grain.numFramesActive * grain.envIncSamples) > ENV_LUT_SIZE; });
+bool ArcSpectrogram::isLevelInProgress() const {
+  const int selected = mSpecType.getSelectedItemIndex();
+  if (selected < 0) return false;
+  return (mLevelsStarted[selected] & ~mLevelsComplete[selected]) != 0;
 }
 
 void ArcSpectrogram::resized() {
@@ -134,159 +192,350 @@ void ArcSpectrogram::resized() {
   mStartRadius = getHeight() / 4.0f;
   mEndRadius = getHeight();
   mBowWidth = mEndRadius - mStartRadius;
+  mIsBackgroundDirty = true;
+}
+
+void ArcSpectrogram::startLevel(ParamUI::SpecType type, int level) {
+  const int height = getLevelHeight(level);
+  const int width = height * 2;
+  // Created here so paint() never sees the image swapped from another thread, the jobs share its pixels. A software image
+  // so the tiles write to plain memory at the same time
+  juce::Image image(juce::Image::ARGB, width, height, true, juce::SoftwareImageType());
+  mLevels[type][level] = image;
+  mLevelsStarted[type] |= (1u << level);
+  mImagesStarted |= (1u << type);
+  const int generation = mGeneration;
+  const juce::Range<float> timeRange = mTimeRange;
+  // Each start of a level counts its own tiles, jobs of a thrown away generation can still be finishing
+  auto tilesLeft = std::make_shared<std::atomic<int>>(0);
+
+  // Show the image being generated until one of the views is done
+  if (mImagesComplete == 0 && (int)type < mSpecType.getNumItems()) {
+    mSpecType.setSelectedItemIndex(type, juce::sendNotification);
+  }
+
+  // Audio waveform (1D) is handled a bit differently than its 2D spectrograms, a single job draws it
+  if (type == ParamUI::SpecType::WAVEFORM) {
+    const juce::AudioBuffer<float>* audioBuffer = (juce::AudioBuffer<float>*)mBuffers[type];
+    // About 2 pixels wide on screen at the current size
+    const float lineWidth = 2.0f * height / juce::jmax(1, getHeight());
+    tilesLeft->store(1);
+    mImagePool.addJob([this, image, audioBuffer, lineWidth, timeRange, level, generation, tilesLeft]() mutable {
+      drawWaveformImage(image, *audioBuffer, lineWidth, timeRange, generation);
+      onTileComplete(ParamUI::SpecType::WAVEFORM, level, generation, *tilesLeft);
+    });
+    return;
+  }
+
+  // All other types of spectrograms are split in bands of rows, every pixel only depends on the spec
+  const Utils::SpecBuffer* spec = (Utils::SpecBuffer*)mBuffers[type];
+  if (spec->size() == 0) return;
+  const int maxRow = (type == ParamUI::SpecType::SPECTROGRAM) ? spec->getNumBins() / 8 : spec->getNumBins();
+  const int numTiles = (height + TILE_ROWS - 1) / TILE_ROWS;
+  tilesLeft->store(numTiles);
+  // The polar table of the larger levels takes a while to build, so it is done on the pool too
+  mImagePool.addJob([this, image, spec, maxRow, timeRange, type, level, numTiles, generation, tilesLeft]() {
+    if (generation != mGeneration) return;
+    std::shared_ptr<const PolarTable> table;
+    {
+      const juce::ScopedLock lock(mPolarTableLock);
+      table = mPolarTables[level].lock();
+      if (table == nullptr) {
+        table = makePolarTable(image.getWidth(), image.getHeight());
+        mPolarTables[level] = table;
+      }
+    }
+    for (int tile = 0; tile < numTiles; ++tile) {
+      const int startY = tile * TILE_ROWS;
+      const int endY = juce::jmin(image.getHeight(), startY + TILE_ROWS);
+      mImagePool.addJob(
+          [this, image, spec, maxRow, timeRange, table, startY, endY, type, level, generation, tilesLeft]() mutable {
+            drawSpecImage(image, *spec, maxRow, timeRange, *table, startY, endY, generation);
+            onTileComplete(type, level, generation, *tilesLeft);
+          });
+    }
+  });
 }
 
-void ArcSpectrogram::run() {
+void ArcSpectrogram::drawWaveformImage(juce::Image& image, const juce::AudioBuffer<float>& audioBuffer, float lineWidth,
+                                       juce::Range<float> timeRange, int generation) {
   // Initialize rainbow parameters
-  int startRadius = getHeight() / 4.0f;
-  int endRadius = getHeight();
+  int startRadius = image.getHeight() / 4.0f;
+  int endRadius = image.getHeight();
   int bowWidth = endRadius - startRadius;
-  juce::Point<int> startPoint = juce::Point<int>(getWidth() / 2, getHeight());
-  mParamUI.specImages[mParamUI.specType] = juce::Image(juce::Image::ARGB, getWidth(), getHeight(), true);
-  juce::Graphics g(mParamUI.specImages[mParamUI.specType]);
-
-  // Audio waveform (1D) is handled a bit differently than its 2D spectrograms
-  if (mParamUI.specType == ParamUI::SpecType::WAVEFORM) {
-    juce::AudioBuffer<float>* audioBuffer = (juce::AudioBuffer<float>*)mBuffers[mParamUI.specType];
-    const float* bufferSamples = audioBuffer->getReadPointer(0);
-    float maxMagnitude = audioBuffer->getMagnitude(0, audioBuffer->getNumSamples());
-
-    // Draw NUM_COLS worth of audio samples
-    juce::Point<float> prevPoint = startPoint.getPointOnCircumference(startRadius + bowWidth / 2.0f, startRadius + bowWidth / 2.0f,
-                                                                      -(juce::MathConstants<float>::pi / 2.0f));
-    juce::Colour prevColour = juce::Colours::black;
-    for (auto i = 0; i < NUM_COLS; ++i) {
-      if (threadShouldExit()) return;
-      int sampleIdx = ((float)i / NUM_COLS) * audioBuffer->getNumSamples();
-      float sampleRadius = juce::jmap(bufferSamples[sampleIdx], -maxMagnitude, maxMagnitude, (float)startRadius, (float)endRadius);
-
-      // Choose rainbow color depending on radius
-      auto rainbowColour =
-          juce::Colour::fromHSV(juce::jmap(bufferSamples[sampleIdx], -maxMagnitude, maxMagnitude, 0.0f, 1.0f), 1.0, 1.0f, 1.0f);
-
-      // Draw a line connecting to the previous point, blending colours between them
-      float xPerc = ((float)i / NUM_COLS);
-      float angleRad = (juce::MathConstants<float>::pi * xPerc) - (juce::MathConstants<float>::pi / 2.0f);
-      juce::Point<float> p = startPoint.getPointOnCircumference(sampleRadius, sampleRadius, angleRad);
-      juce::ColourGradient gradient = juce::ColourGradient(prevColour, prevPoint, rainbowColour, p, false);
-      g.setGradientFill(gradient);
-      g.drawLine(juce::Line<float>(prevPoint, p), 2.0f);
-      prevPoint = p;
-      prevColour = rainbowColour;
+  juce::Point<int> startPoint = juce::Point<int>(image.getWidth() / 2, image.getHeight());
+  juce::Graphics g(image);
+  const float* bufferSamples = audioBuffer.getReadPointer(0);
+  float maxMagnitude = audioBuffer.getMagnitude(0, audioBuffer.getNumSamples());
+
+  // Draw NUM_COLS worth of audio samples
+  juce::Point<float> prevPoint = startPoint.getPointOnCircumference(startRadius + bowWidth / 2.0f, startRadius + bowWidth / 2.0f,
+                                                                    -(juce::MathConstants<float>::pi / 2.0f));
+  juce::Colour prevColour = juce::Colours::black;
+  for (auto i = 0; i < NUM_COLS; ++i) {
+    if (generation != mGeneration) return;
+    float xPerc = ((float)i / NUM_COLS);
+    int sampleIdx = juce::jmin(audioBuffer.getNumSamples() - 1,
+                               (int)((timeRange.getStart() + xPerc * timeRange.getLength()) * audioBuffer.getNumSamples()));
+    float sampleRadius = juce::jmap(bufferSamples[sampleIdx], -maxMagnitude, maxMagnitude, (float)startRadius, (float)endRadius);
+
+    // Choose rainbow color depending on radius
+    auto rainbowColour =
+        juce::Colour::fromHSV(juce::jmap(bufferSamples[sampleIdx], -maxMagnitude, maxMagnitude, 0.0f, 1.0f), 1.0, 1.0f, 1.0f);
+
+    // Draw a line connecting to the previous point, blending colours between them
+    float angleRad = (juce::MathConstants<float>::pi * xPerc) - (juce::MathConstants<float>::pi / 2.0f);
+    juce::Point<float> p = startPoint.getPointOnCircumference(sampleRadius, sampleRadius, angleRad);
+    juce::ColourGradient gradient = juce::ColourGradient(prevColour, prevPoint, rainbowColour, p, false);
+    g.setGradientFill(gradient);
+    g.drawLine(juce::Line<float>(prevPoint, p), lineWidth);
+    prevPoint = p;
+    prevColour = rainbowColour;
+  }
+}
+
+std::shared_ptr<const ArcSpectrogram::PolarTable> ArcSpectrogram::makePolarTable(int width, int height) {
+  auto table = std::make_shared<PolarTable>();
+  table->width = width;
+  table->height = height;
+  // Same layout as resized()
+  const float centerX = width / 2.0f;
+  const float centerY = (float)height;
+  const float startRadius = (int)(height / 4.0f);
+  const float bowWidth = height - startRadius;
+
+  table->rows.resize(height);
+  for (int y = 0; y < height; ++y) {
+    const float dy = centerY - (y + 0.5f);
+    // Pixels past the outer edge of the bow are never drawn
+    const float halfChord = std::sqrt(juce::jmax(0.0f, (float)(height * height) - dy * dy));
+    PolarRow& row = table->rows[y];
+    row.first = juce::jlimit(0, width, (int)std::floor(centerX - halfChord));
+    row.end = juce::jlimit(row.first, width, (int)std::ceil(centerX + halfChord));
+    row.offset = (int)table->pixels.size();
+    for (int x = row.first; x < row.end; ++x) {
+      const float dx = (x + 0.5f) - centerX;
+      const float radPerc = (std::sqrt(dx * dx + dy * dy) - startRadius) / bowWidth;
+      // Angle from straight up, -pi/2 on the left to pi/2 on the right
+      const float angleRad = std::atan2(dx, dy);
+      const float xPerc = juce::jlimit(0.0f, 1.0f, (angleRad / juce::MathConstants<float>::pi) + 0.5f);
+      const bool isOnBow = radPerc >= 0.0f && radPerc < 1.0f;
+      table->pixels.push_back({(juce::uint16)(xPerc * POLAR_MAX + 0.5f),
+                               isOnBow ? (juce::uint16)(radPerc * POLAR_MAX) : (juce::uint16)POLAR_OFF_BOW});
     }
-  } else {
-    // All other types of spectrograms
-    Utils::SpecBuffer& spec = *(Utils::SpecBuffer*)mBuffers[mParamUI.specType];  // cast to SpecBuffer
-    if (spec.size() == 0 || threadShouldExit()) return;
-
-    int maxRow = (mParamUI.specType == ParamUI::SpecType::SPECTROGRAM) ? spec[0].size() / 8 : spec[0].size();
-
-    // Draw each column of frequencies
-    for (auto i = 0; i < NUM_COLS; ++i) {
-      if (threadShouldExit()) return;
-      auto specCol = ((float)i / NUM_COLS) * spec.size();
-      // Draw each row of frequencies
-      for (auto curRadius = startRadius; curRadius < endRadius; curRadius += 1) {
-        float radPerc = (curRadius - startRadius) / (float)bowWidth;
-        auto specRow = radPerc * maxRow;
-
-        // Choose rainbow color depending on radius
-        auto level = juce::jlimit(0.0f, 1.0f, spec[specCol][specRow] * spec[specCol][specRow] * COLOUR_MULTIPLIER);
-        auto rainbowColour = juce::Colour::fromHSV(radPerc, 1.0, 1.0f, level);
-        g.setColour(rainbowColour);
-
-        float xPerc = (float)specCol / spec.size();
-        float angleRad = (juce::MathConstants<float>::pi * xPerc) - (juce::MathConstants<float>::pi / 2.0f);
-
-        // Create and rotate a rectangle to represent the "pixel"
-        juce::Point<float> p = startPoint.getPointOnCircumference(curRadius, curRadius, angleRad);
-        juce::AffineTransform rotation = juce::AffineTransform();
-        rotation = rotation.rotated(angleRad, p.x, p.y);
-        juce::Rectangle<float> rect = juce::Rectangle<float>(2, 2);
-        rect = rect.withCentre(p);
-        rect = rect.transformedBy(rotation);
-        juce::Path rectPath;
-        rectPath.addRectangle(rect);
-
-        // Finally, draw the rectangle
-        g.fillPath(rectPath, rotation);
-      }
+  }
+  return table;
+}
+
+void ArcSpectrogram::drawSpecImage(juce::Image& image, const Utils::SpecBuffer& spec, int maxRow, juce::Range<float> timeRange,
+                                   const PolarTable& table, int startY, int endY, int generation) {
+  const int lastCol = (int)spec.size() - 1;
+  const int lastBin = juce::jmax(0, maxRow - 1);
+  // Arc position to spec column, only timeRange of the spec is spread over the arc
+  const float colScale = timeRange.getLength() * lastCol / POLAR_MAX;
+  const float colOffset = timeRange.getStart() * lastCol;
+  const float binScale = lastBin / (float)POLAR_MAX;
+
+  // Only this tile's rows, other jobs write the rest of the image at the same time. Pixels off the bow are left as they are
+  // (cleared), so this has to read back
+  juce::Image::BitmapData bitmap(image, 0, startY, table.width, endY - startY, juce::Image::BitmapData::readWrite);
+  for (int y = startY; y < endY; ++y) {
+    if (generation != mGeneration) return;
+    const PolarRow& row = table.rows[y];
+    const PolarPixel* polarPixel = table.pixels.data() + row.offset;
+    for (int x = row.first; x < row.end; ++x, ++polarPixel) {
+      if (polarPixel->radPerc == POLAR_OFF_BOW) continue;
+      // Bilinear sample of the spec, time along the arc and frequency along the radius
+      const float colPos = colOffset + polarPixel->xPerc * colScale;
+      const float binPos = polarPixel->radPerc * binScale;
+      const int col = juce::jlimit(0, lastCol, (int)colPos);
+      const int bin = juce::jlimit(0, lastBin, (int)binPos);
+      const int nextCol = juce::jmin(col + 1, lastCol);
+      const int nextBin = juce::jmin(bin + 1, lastBin);
+      const float colFrac = juce::jlimit(0.0f, 1.0f, colPos - col);
+      const float binFrac = juce::jlimit(0.0f, 1.0f, binPos - bin);
+      const std::span<const float> left = spec[col];
+      const std::span<const float> right = spec[nextCol];
+      const float low = left[bin] + colFrac * (right[bin] - left[bin]);
+      const float high = left[nextBin] + colFrac * (right[nextBin] - left[nextBin]);
+      const float value = low + binFrac * (high - low);
+
+      // Rainbow colour by radius, louder is more opaque
+      const float level = juce::jlimit(0.0f, 1.0f, value * value * COLOUR_MULTIPLIER);
+      juce::PixelARGB pixel = mHueTable[(polarPixel->radPerc * (HUE_TABLE_SIZE - 1)) / POLAR_MAX];
+      pixel.multiplyAlpha(level);
+      *reinterpret_cast<juce::PixelARGB*>(bitmap.getPixelPointer(x, y - startY)) = pixel;
     }
   }
+}
 
-  // pass type as another thread can change member variable right after run() is
-  // done
-  onImageComplete(mParamUI.specType);
-  mIsProcessing = false;
+void ArcSpectrogram::onTileComplete(ParamUI::SpecType specType, int level, int generation, std::atomic<int>& tilesLeft) {
+  // Only the last tile gets here, checked again on the message thread as the images can be thrown away until then
+  if (--tilesLeft != 0 || generation != mGeneration) return;
+  juce::Component::SafePointer<ArcSpectrogram> safeThis(this);
+  juce::MessageManager::callAsync([safeThis, specType, level, generation]() {
+    if (safeThis != nullptr && generation == safeThis->mGeneration) safeThis->onLevelComplete(specType, level);
+  });
 }
 
-void ArcSpectrogram::onImageComplete(ParamUI::SpecType specType) {
-  mImagesComplete[specType] = true;
-  for (int i = 0; i < (int)ParamUI::SpecType::COUNT; i++) {
-    if (mImagesComplete[(ParamUI::SpecType)i] == false) {
-      return;
+void ArcSpectrogram::onLevelComplete(ParamUI::SpecType specType, int level) {
+  mLevelsComplete[specType] |= (1u << level);
+  // Presets save the best image of the whole input done so far
+  if (mTimeRange == juce::Range<float>(0.0f, 1.0f)) {
+    for (int i = NUM_LEVELS - 1; i >= 0; --i) {
+      if (mLevelsComplete[specType] & (1u << i)) {
+        mParamUI.specImages[specType] = mLevels[specType][i];
+        break;
+      }
     }
   }
+  if (isImageComplete(specType)) {
+    invalidateBackground();
+  } else {
+    onImageComplete(specType);
+  }
+}
+
+void ArcSpectrogram::onImageComplete(ParamUI::SpecType specType) {
+  mImagesComplete |= (1u << specType);
+  mSpecType.setItemEnabled(specType + 1, true);
+  // The first view done is shown right away, the others keep generating in the background
+  const int selected = mSpecType.getSelectedItemIndex();
+  if (selected < 0 || !isImageComplete((ParamUI::SpecType)selected)) {
+    mSpecType.setSelectedItemIndex(specType, juce::sendNotification);
+  }
+  invalidateBackground();
+
+  if (mImagesComplete != ALL_IMAGES) return;
   mParamUI.specComplete = true;
   // Lets UI know it so it can enable other UI components
-  onImagesComplete();
+  if (onImagesComplete != nullptr) onImagesComplete();
+}
+
+void ArcSpectrogram::cancelImages() {
+  // Jobs still running see the new generation and stop at their next row. They read the synth's buffers, so wait for them
+  // before anything can replace those
+  mGeneration++;
+  mImagePool.removeAllJobs(true, BUFFER_PROCESS_TIMEOUT);
+  // A job setting up a level may have queued its tiles while the first call waited on it
+  mImagePool.removeAllJobs(true, BUFFER_PROCESS_TIMEOUT);
+  mBuffers.fill(nullptr);
+  mImagesStarted = 0;
+  mImagesComplete = 0;
+  for (int i = 0; i < (int)ParamUI::SpecType::COUNT; i++) {
+    mLevels[i].fill(juce::Image());
+    mLevelsStarted[i] = 0;
+    mLevelsComplete[i] = 0;
+    mSpecType.setItemEnabled(i + 1, false);
+  }
+  invalidateBackground();
+}
+
+void ArcSpectrogram::setTimeRange(juce::Range<float> timeRange) {
+  // Needs every view drawn and its buffer still around, preset images can't be zoomed
+  for (int i = 0; i < (int)ParamUI::SpecType::COUNT; i++) {
+    if (!isImageComplete((ParamUI::SpecType)i) || !canDrawLevels((ParamUI::SpecType)i)) return;
+  }
+  timeRange = timeRange.withLength(juce::jlimit(MIN_TIME_RANGE, 1.0f, timeRange.getLength()));
+  timeRange = juce::Range<float>(0.0f, 1.0f).constrainRange(timeRange);
+  if (timeRange == mTimeRange) return;
+  mTimeRange = timeRange;
+
+  // Every level was drawn for the old range, paint() asks for the ones needed again
+  mGeneration++;
+  for (int i = 0; i < (int)ParamUI::SpecType::COUNT; i++) {
+    mLevels[i].fill(juce::Image());
+    mLevelsStarted[i] = 0;
+    mLevelsComplete[i] = 0;
+  }
+  invalidateBackground();
+}
+
+void ArcSpectrogram::mouseWheelMove(const juce::MouseEvent& event, const juce::MouseWheelDetails& wheel) {
+  // Zooms around the part of the input under the mouse, which stays where it is on the arc
+  const float dx = event.position.x - mCenterPoint.x;
+  const float dy = mCenterPoint.y - event.position.y;
+  const float arcRatio = juce::jlimit(0.0f, 1.0f, (std::atan2(dx, dy) / juce::MathConstants<float>::pi) + 0.5f);
+  const float posRatio = mTimeRange.getStart() + arcRatio * mTimeRange.getLength();
+  const float length = mTimeRange.getLength() * std::exp(-wheel.deltaY * ZOOM_SPEED);
+  setTimeRange(juce::Range<float>::withStartAndLength(posRatio - arcRatio * length, length));
+}
+
+void ArcSpectrogram::mouseDoubleClick(const juce::MouseEvent&) { setTimeRange(juce::Range<float>(0.0f, 1.0f)); }
+
+int ArcSpectrogram::getLevel(float physicalHeight) {
+  for (int level = 0; level < NUM_LEVELS; ++level) {
+    if (getLevelHeight(level) >= physicalHeight) return level;
+  }
+  return NUM_LEVELS - 1;
+}
+
+int ArcSpectrogram::getWantedLevel() const {
+  return getLevel(getHeight() * juce::Component::getApproximateScaleFactorForComponent(this));
+}
+
+int ArcSpectrogram::findLevelToDraw(ParamUI::SpecType type, int wantedLevel) const {
+  const juce::uint32 complete = mLevelsComplete[type];
+  if (complete & (1u << wantedLevel)) return wantedLevel;
+  // Nearest one done, larger first since scaling down stays sharp
+  for (int distance = 1; distance < NUM_LEVELS; ++distance) {
+    if (wantedLevel + distance < NUM_LEVELS && (complete & (1u << (wantedLevel + distance)))) return wantedLevel + distance;
+    if (wantedLevel - distance >= 0 && (complete & (1u << (wantedLevel - distance)))) return wantedLevel - distance;
+  }
+  // Nothing done yet, show it being drawn
+  if (mLevelsStarted[type] & (1u << wantedLevel)) return wantedLevel;
+  for (int level = 0; level < NUM_LEVELS; ++level) {
+    if (mLevelsStarted[type] & (1u << level)) return level;
+  }
+  return -1;
+}
+
+juce::Rectangle<float> ArcSpectrogram::getArcBounds() const {
+  return juce::Rectangle<float>(getWidth() / 2.0f - getHeight(), 0.0f, getHeight() * 2.0f, (float)getHeight());
 }
 
 void ArcSpectrogram::reset() {
+  cancelImages();
+  mTimeRange = juce::Range<float>(0.0f, 1.0f);
   // Reset all images
   for (int i = 0; i < mParamUI.specImages.size(); i++) {
     mParamUI.specImages[i].clear(mParamUI.specImages[i].getBounds());
   }
-  for (int i = 0; i < (int)ParamUI::SpecType::COUNT; i++) {
-    mImagesComplete[(ParamUI::SpecType)i] = false;
-  }
   mParamUI.specComplete = false;
   // might be lingering grains
   mArcGrains.clear();
 }
 
 void ArcSpectrogram::loadSpecBuffer(Utils::SpecBuffer* buffer, ParamUI::SpecType type) {
-  if (buffer == nullptr) return;
-  waitForThreadToExit(BUFFER_PROCESS_TIMEOUT);
-  if (mImagesComplete[type]) return;
-
-  mParamUI.specType = type;
-  mBuffers[mParamUI.specType] = buffer;
-
-  // As each buffer is loaded, want to display it being generated
-  // Will be loaded in what ever order loaded from async callbacks
-  // The last item loaded will be the first item selected in ComboBox
-  if ((int)mParamUI.specType < mSpecType.getNumItems()) {
-    mSpecType.setSelectedItemIndex(mParamUI.specType, juce::sendNotification);
-  }
+  if (buffer == nullptr || !shouldLoadImage(type)) return;
+  mBuffers[type] = buffer;
   // Only make image if component size has been set
-  if (getWidth() > 0 && getHeight() > 0) {
-    mIsProcessing = true;
-    startThread();
-  }
+  if (getWidth() > 0 && getHeight() > 0) startLevel(type, getWantedLevel());
 }
 
 void ArcSpectrogram::loadWaveformBuffer(juce::AudioBuffer<float>* audioBuffer) {
-  if (audioBuffer == nullptr) return;
-  waitForThreadToExit(BUFFER_PROCESS_TIMEOUT);
-  if (mImagesComplete[ParamUI::SpecType::WAVEFORM]) return;
-
-  mParamUI.specType = ParamUI::SpecType::WAVEFORM;
-  mBuffers[mParamUI.specType] = audioBuffer;
-
+  if (audioBuffer == nullptr || !shouldLoadImage(ParamUI::SpecType::WAVEFORM)) return;
+  mBuffers[ParamUI::SpecType::WAVEFORM] = audioBuffer;
   // Only make image if component size has been set
-  if (getWidth() > 0 && getHeight() > 0) {
-    mIsProcessing = true;
-    startThread();
-  }
+  if (getWidth() > 0 && getHeight() > 0) startLevel(ParamUI::SpecType::WAVEFORM, getWantedLevel());
 }
 
 // loadSpecBuffer is never called when a preset is loaded
 void ArcSpectrogram::loadPreset() {
+  // The preset has every image besides the waveform, which is still generated from the audio. Its images are drawn as they
+  // are since there are no buffers to draw levels from
+  cancelImages();
+  mTimeRange = juce::Range<float>(0.0f, 1.0f);
+  const juce::uint32 presetImages = ALL_IMAGES & ~(1u << ParamUI::SpecType::WAVEFORM);
+  mImagesStarted = presetImages;
+  mImagesComplete = presetImages;
+  for (int i = 0; i < (int)ParamUI::SpecType::COUNT; i++) {
+    mSpecType.setItemEnabled(i + 1, isImageComplete((ParamUI::SpecType)i));
+  }
   // make visible if preset was loaded first
   mParamUI.specComplete = true;
   mSpecType.setSelectedItemIndex(mParamUI.specType, juce::dontSendNotification);
-  repaint();
+  invalidateBackground();
 }
 
 void ArcSpectrogram::setMidiNotes(const juce::Array<Utils::MidiNote>& midiNotes) {
@@ -9,6 +9,14 @@
     HPCP profile, and detected notes. It also displays the grain positions
     and visualizes grains that are playing.
 
+    Each view is kept as a pyramid of images of the whole half disc at
+    power of two heights, rendered from the spec buffers as they are
+    needed. Painting picks the smallest level at least as tall as the arc
+    is in physical pixels, so resizing and HiDPI only ever scale down.
+
+    The selected level is composited once into a background image, each
+    frame only the boxes of the grains that moved are repainted over it.
+
   ==============================================================================
 */
 
@@ -20,33 +28,43 @@
 #include <bitset>
 
 #include "../DSP/Fft.h"
+#include "../DSP/GrainEventFifo.h"
 #include "../Parameters.h"
 #include "../Utils.h"
 
 //==============================================================================
 /*
  */
-class ArcSpectrogram : public juce::AnimatedAppComponent, juce::Thread {
+class ArcSpectrogram : public juce::Component, juce::Timer {
  public:
-  ArcSpectrogram(ParamsNote &paramsNote, ParamUI &paramUI);
+  ArcSpectrogram(ParamsNote &paramsNote, ParamUI &paramUI, GrainEventFifo &grainEvents);
   ~ArcSpectrogram() override;
 
-  void update() override{};
+  void timerCallback() override;
   void paint(juce::Graphics &) override;
   void resized() override;
 
   void reset();
-  bool shouldLoadImage(ParamUI::SpecType type) { return !mIsProcessing && !mImagesComplete[type]; }
+  // Stops drawing and forgets the buffers, call before the synth replaces the buffers being drawn
+  void cancelImages();
+  // Each image is generated once per load, all of them at the same time
+  bool shouldLoadImage(ParamUI::SpecType type) const { return !(mImagesStarted & (1u << type)); }
+  bool isImageComplete(ParamUI::SpecType type) const { return mImagesComplete & (1u << type); }
   void loadSpecBuffer(Utils::SpecBuffer *buffer, ParamUI::SpecType type);
   void loadWaveformBuffer(juce::AudioBuffer<float> *audioBuffer);  // Raw audio samples from file
   void loadPreset();
   void setMidiNotes(const juce::Array<Utils::MidiNote> &midiNotes);
   void setSpecType(ParamUI::SpecType type) { mSpecType.setSelectedItemIndex(type, juce::dontSendNotification); }
+  // Part of the input (0 to 1) shown along the arc, the mouse wheel zooms and a double click shows everything again
+  void setTimeRange(juce::Range<float> timeRange);
+  juce::Range<float> getTimeRange() const { return mTimeRange; }
+  // Where a position in the input (0 to 1) is along the arc, outside 0 to 1 when zoomed out of view
+  float getArcRatio(float posRatio) const { return (posRatio - mTimeRange.getStart()) / mTimeRange.getLength(); }
 
-  //============================================================================
-  void run() override;
+  void mouseWheelMove(const juce::MouseEvent &event, const juce::MouseWheelDetails &wheel) override;
+  void mouseDoubleClick(const juce::MouseEvent &event) override;
 
-  // Callback functions when all images are created
+  // Callback functions when all images are created, called on the message thread
   std::function<void(void)> onImagesComplete = nullptr;
 
  private:
@@ -59,19 +77,41 @@ class ArcSpectrogram : public juce::AnimatedAppComponent, juce::Thread {
   static constexpr auto SPEC_TYPE_HEIGHT = 50;
   static constexpr auto SPEC_TYPE_WIDTH = 130;
   static constexpr auto MAX_GRAIN_SIZE = 40;
-  static constexpr auto MAX_NUM_GRAINS = 40;
+  static constexpr auto GRAIN_LINE_WIDTH = 2.0f;
   static constexpr auto NUM_COLS = 600;
+  static constexpr auto TILE_ROWS = 32;  // Image rows drawn by a single job
+  static constexpr juce::uint32 ALL_IMAGES = (1u << ParamUI::SpecType::COUNT) - 1;
+  // Image pyramid, level heights double from MIN_LEVEL_HEIGHT and the images are twice as wide as tall
+  static constexpr auto MIN_LEVEL_HEIGHT = 256;
+  static constexpr auto NUM_LEVELS = 4;
+  // Zoom
+  static constexpr auto MIN_TIME_RANGE = 0.02f;
+  static constexpr auto ZOOM_SPEED = 2.0f;
   // Colours
   static constexpr auto COLOUR_MULTIPLIER = 20.0f;
+  static constexpr auto HUE_TABLE_SIZE = 1024;  // Rainbow colours by radius, finer than any bow is wide in pixels
 
+  // Everything about the grain's path is worked out when its event is drained, each frame only looks up its envelope
   typedef struct ArcGrain {
-    ParamGenerator *paramGenerator;
+    ParamGenerator *paramGenerator;  // Only for its envelope
     float gain;
     float envIncSamples;  // How many envelope samples to increment each frame
     int numFramesActive;
-    Utils::PitchClass pitchClass;
-    ArcGrain(ParamGenerator *paramGenerator, float gain, float envIncSamples, Utils::PitchClass pitchClass)
-        : paramGenerator(paramGenerator), gain(gain), envIncSamples(envIncSamples), numFramesActive(0), pitchClass(pitchClass) {}
+    float posRatio;     // Where in the input (0 to 1) the grain starts
+    float posTravel;    // How far through the input it moves over its duration
+    float radiusRatio;  // 0 to 1 from the inner to outer edge of the bow, from its pitch
+    juce::Colour colour;
+    juce::Rectangle<float> rect;  // Where it is drawn this frame, empty if not drawn
+    ArcGrain(ParamGenerator *paramGenerator, float gain, float envIncSamples, float posRatio, float posTravel, float radiusRatio,
+             juce::Colour colour)
+        : paramGenerator(paramGenerator),
+          gain(gain),
+          envIncSamples(envIncSamples),
+          numFramesActive(0),
+          posRatio(posRatio),
+          posTravel(posTravel),
+          radiusRatio(radiusRatio),
+          colour(colour) {}
   } ArcGrain;
 
   // Parameters
@@ -79,6 +119,7 @@ class ArcSpectrogram : public juce::AnimatedAppComponent, juce::Thread {
   // to restore the state
   ParamsNote &mParamsNote;
   ParamUI &mParamUI;
+  GrainEventFifo &mGrainEvents;  // Drained once per frame
 
   // Buffers used to generate the images
   std::array<void *, ParamUI::SpecType::COUNT> mBuffers;
@@ -86,8 +127,20 @@ class ArcSpectrogram : public juce::AnimatedAppComponent, juce::Thread {
   // Bookkeeping
   std::bitset<Utils::PitchClass::COUNT> mActivePitchClass;
   juce::Array<ArcGrain> mArcGrains;
-  bool mIsProcessing = false;
-  bool mImagesComplete[ParamUI::SpecType::COUNT];
+  // Images are drawn in tiles on the pool, one bit per SpecType
+  juce::ThreadPool mImagePool;
+  std::atomic<juce::uint32> mImagesStarted{0};
+  std::atomic<juce::uint32> mImagesComplete{0};
+  std::atomic<int> mGeneration{0};  // Bumped when images are thrown away, jobs of an older generation stop early
+  // Image pyramid of each SpecType, one bit per level. Only the message thread changes these, jobs keep their own reference to
+  // the image they draw
+  std::array<std::array<juce::Image, NUM_LEVELS>, ParamUI::SpecType::COUNT> mLevels;
+  std::array<juce::uint32, ParamUI::SpecType::COUNT> mLevelsStarted{};
+  std::array<juce::uint32, ParamUI::SpecType::COUNT> mLevelsComplete{};
+  juce::Range<float> mTimeRange{0.0f, 1.0f};
+  // Black fill and the view's image at the physical size, redrawn only when the view changes
+  juce::Image mBackground;
+  bool mIsBackgroundDirty = true;
 
   // UI values saved on resize
   juce::Point<float> mCenterPoint;
@@ -99,8 +152,66 @@ class ArcSpectrogram : public juce::AnimatedAppComponent, juce::Thread {
   std::mt19937 mGenRandom{mRandomDevice()};
   std::normal_distribution<> mNormalRand{0.0f, 0.4f};
 
+  // Where each pixel of a level falls on the arc, the same for every spec type. Kept to 16 bits as the largest level has
+  // millions of pixels on the bow
+  static constexpr auto POLAR_MAX = 0xFFFE;
+  static constexpr auto POLAR_OFF_BOW = 0xFFFF;
+  typedef struct PolarPixel {
+    juce::uint16 xPerc;    // 0 to POLAR_MAX along the arc from left to right (time)
+    juce::uint16 radPerc;  // 0 to POLAR_MAX from the inner to outer edge of the bow (frequency), or POLAR_OFF_BOW
+  } PolarPixel;
+  // Only the pixels from first up to end of each row can be on the bow
+  typedef struct PolarRow {
+    int first;
+    int end;
+    int offset;  // Index of the row's first pixel in pixels
+  } PolarRow;
+  typedef struct PolarTable {
+    int width;
+    int height;
+    std::vector<PolarPixel> pixels;
+    std::vector<PolarRow> rows;
+  } PolarTable;
+  // Owned by the jobs drawing a level, so a table only lives while it is used
+  std::array<std::weak_ptr<const PolarTable>, NUM_LEVELS> mPolarTables;
+  juce::CriticalSection mPolarTableLock;
+  std::array<juce::PixelARGB, HUE_TABLE_SIZE> mHueTable;
+
   juce::ComboBox mSpecType;
 
+  static int getLevelHeight(int level) { return MIN_LEVEL_HEIGHT << level; }
+  // Smallest level at least physicalHeight tall, or the largest
+  static int getLevel(float physicalHeight);
+  int getWantedLevel() const;  // For the current size and display scale
+  // Level to paint for the wanted one, the nearest done or else the one still being drawn. -1 if there is none
+  int findLevelToDraw(ParamUI::SpecType type, int wantedLevel) const;
+  // Arc of the full half disc in component coordinates, what every level image is drawn into
+  juce::Rectangle<float> getArcBounds() const;
+  bool canDrawLevels(ParamUI::SpecType type) const { return mBuffers[type] != nullptr; }
+  // Any level of the selected view still being drawn, the background then follows it every frame
+  bool isLevelInProgress() const;
+  void drawBackground(float scale);
+  void invalidateBackground() {
+    mIsBackgroundDirty = true;
+    repaint();
+  }
+  void addGrain(const GrainEvent &event);
+  // Rectangle the grain is drawn in at its current frame, empty if out of view
+  juce::Rectangle<float> getGrainRect(const ArcGrain &grain) const;
+  static juce::Rectangle<int> getGrainBounds(const ArcGrain &grain) {
+    return grain.rect.isEmpty() ? juce::Rectangle<int>() : grain.rect.expanded(GRAIN_LINE_WIDTH).getSmallestIntegerContainer();
+  }
+  void startLevel(ParamUI::SpecType type, int level);
+  void drawWaveformImage(juce::Image &image, const juce::AudioBuffer<float> &audioBuffer, float lineWidth,
+                         juce::Range<float> timeRange, int generation);
+  static std::shared_ptr<const PolarTable> makePolarTable(int width, int height);
+  // Writes the pixels on the bow in rows [startY, endY) straight into the image, sampling spec at each pixel's arc position
+  void drawSpecImage(juce::Image &image, const Utils::SpecBuffer &spec, int maxRow, juce::Range<float> timeRange,
+                     const PolarTable &table, int startY, int endY, int generation);
+  // Called from the pool, the last tile of a level (tilesLeft is shared by its tiles) hands it to onLevelComplete() on the message
+  // thread
+  void onTileComplete(ParamUI::SpecType specType, int level, int generation, std::atomic<int> &tilesLeft);
+  void onLevelComplete(ParamUI::SpecType specType, int level);
   void onImageComplete(ParamUI::SpecType specType);
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ArcSpectrogram)
@@ -17,7 +17,9 @@ GrainControl::GrainControl(Parameters& parameters)
       mSliderPitchAdjust(parameters, ParamCommon::Type::PITCH_ADJUST),
       mSliderPitchSpray(parameters, ParamCommon::Type::PITCH_SPRAY),
       mSliderPosAdjust(parameters, ParamCommon::Type::POS_ADJUST),
-      mSliderPosSpray(parameters, ParamCommon::Type::POS_SPRAY)
+      mSliderPosSpray(parameters, ParamCommon::Type::POS_SPRAY),
+      mSliderPanAdjust(parameters, ParamCommon::Type::PAN_ADJUST),
+      mSliderPanSpray(parameters, ParamCommon::Type::PAN_SPRAY)
 {
 
   juce::Colour colour = Utils::GLOBAL_COLOUR;
@@ -72,6 +74,33 @@ GrainControl::GrainControl(Parameters& parameters)
   mLabelPosSpray.setJustificationType(juce::Justification::centredTop);
   addAndMakeVisible(mLabelPosSpray);
 
+  // Adjust pan, both are bars so they fit under the position changer
+  mSliderPanAdjust.setSliderStyle(juce::Slider::SliderStyle::LinearBar);
+  mSliderPanAdjust.setNumDecimalPlacesToDisplay(2);
+  mSliderPanAdjust.setColour(juce::Slider::ColourIds::textBoxOutlineColourId, colour);
+  mSliderPanAdjust.setColour(juce::Slider::ColourIds::textBoxTextColourId, colour);
+  mSliderPanAdjust.setColour(juce::Slider::ColourIds::trackColourId, juce::Colours::white);
+  mSliderPanAdjust.setRange(ParamRanges::PAN_ADJUST.start, ParamRanges::PAN_ADJUST.end, 0.01);
+  addAndMakeVisible(mSliderPanAdjust);
+
+  mLabelPanAdjust.setText("Pan Adjust", juce::dontSendNotification);
+  mLabelPanAdjust.setColour(juce::Label::ColourIds::textColourId, colour);
+  mLabelPanAdjust.setJustificationType(juce::Justification::centredTop);
+  addAndMakeVisible(mLabelPanAdjust);
+
+  mSliderPanSpray.setSliderStyle(juce::Slider::SliderStyle::LinearBar);
+  mSliderPanSpray.setNumDecimalPlacesToDisplay(2);
+  mSliderPanSpray.setColour(juce::Slider::ColourIds::textBoxOutlineColourId, colour);
+  mSliderPanSpray.setColour(juce::Slider::ColourIds::textBoxTextColourId, colour);
+  mSliderPanSpray.setColour(juce::Slider::ColourIds::trackColourId, juce::Colours::white);
+  mSliderPanSpray.setRange(ParamRanges::PAN_SPRAY.start, ParamRanges::PAN_SPRAY.end, 0.01);
+  addAndMakeVisible(mSliderPanSpray);
+
+  mLabelPanSpray.setText("Pan Spray", juce::dontSendNotification);
+  mLabelPanSpray.setColour(juce::Label::ColourIds::textColourId, colour);
+  mLabelPanSpray.setJustificationType(juce::Justification::centredTop);
+  addAndMakeVisible(mLabelPanSpray);
+
   mPositionChanger.onPositionChanged = [this](bool isRight) {
     ParamGenerator* gen = dynamic_cast<ParamGenerator*>(mParameters.selectedParams);
     jassert(gen != nullptr);
@@ -111,6 +140,10 @@ void GrainControl::timerCallback() {
                               juce::dontSendNotification);
     mSliderPosSpray.setValue(mParameters.getFloatParam(mCurSelectedParams, ParamCommon::Type::POS_SPRAY),
                              juce::dontSendNotification);
+    mSliderPanAdjust.setValue(mParameters.getFloatParam(mCurSelectedParams, ParamCommon::Type::PAN_ADJUST),
+                              juce::dontSendNotification);
+    mSliderPanSpray.setValue(mParameters.getFloatParam(mCurSelectedParams, ParamCommon::Type::PAN_SPRAY),
+                             juce::dontSendNotification);
     if (mCurSelectedParams->type == ParamType::GENERATOR) {
       ParamGenerator* gen = dynamic_cast<ParamGenerator*>(mCurSelectedParams);
       mPositionChanger.setPositionNumber(gen->candidate->get());
@@ -131,6 +164,8 @@ void GrainControl::updateSelectedParams() {
   mSliderPitchSpray.updateSelectedParams();
   mSliderPosAdjust.updateSelectedParams();
   mSliderPosSpray.updateSelectedParams();
+  mSliderPanAdjust.updateSelectedParams();
+  mSliderPanSpray.updateSelectedParams();
   // TODO: disable position changer if not generator type
   bool isGen = mCurSelectedParams->type == ParamType::GENERATOR;
   mPositionChanger.setActive(isGen);
@@ -236,8 +271,14 @@ void GrainControl::resized() {
   mSliderPosAdjust.setBounds(
       positionPanel.removeFromBottom(Utils::KNOB_HEIGHT).withSizeKeepingCentre(Utils::KNOB_HEIGHT * 2, Utils::KNOB_HEIGHT));
 
+  // Pan components
+  mLabelPanSpray.setBounds(paramPanel.removeFromBottom(Utils::LABEL_HEIGHT));
+  mSliderPanSpray.setBounds(paramPanel.removeFromBottom(Utils::LABEL_HEIGHT));
+  mLabelPanAdjust.setBounds(paramPanel.removeFromBottom(Utils::LABEL_HEIGHT));
+  mSliderPanAdjust.setBounds(paramPanel.removeFromBottom(Utils::LABEL_HEIGHT));
+
   // Candidate changer
-  mPositionChanger.setBounds(paramPanel.withSizeKeepingCentre(paramPanel.getWidth(), paramPanel.getHeight() / 2));
+  mPositionChanger.setBounds(paramPanel);
 
   // TODO: param viz rect
 }
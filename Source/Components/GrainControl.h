@@ -47,6 +47,10 @@ class GrainControl : public juce::Component, juce::AudioProcessorParameter::List
   juce::Label mLabelPosAdjust;
   RainbowSlider mSliderPosSpray;
   juce::Label mLabelPosSpray;
+  RainbowSlider mSliderPanAdjust;
+  juce::Label mLabelPanAdjust;
+  RainbowSlider mSliderPanSpray;
+  juce::Label mLabelPanSpray;
 
   // Bookkeeping
   Parameters& mParameters;
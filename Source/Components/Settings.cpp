@@ -16,6 +16,30 @@ void PowerUserSettings::resetParameters() {
   }
 }
 
+void PowerUserSettings::setSpectralWhitening(bool value) {
+  if (mSynth != nullptr) {
+    mSynth->setSpectralWhitening(value);
+  }
+}
+
+bool PowerUserSettings::getSpectralWhitening() { return mSynth != nullptr && mSynth->getSpectralWhitening(); }
+
+void PowerUserSettings::setPolyphonicPitch(bool value) {
+  if (mSynth != nullptr) {
+    mSynth->setNumPitchSegments(value ? PitchDetector::POLYPHONIC_SEGMENTS : 1);
+  }
+}
+
+bool PowerUserSettings::getPolyphonicPitch() { return mSynth != nullptr && mSynth->getNumPitchSegments() > 1; }
+
+void PowerUserSettings::setTrimFromFullAnalysis(bool value) {
+  if (mSynth != nullptr) {
+    mSynth->setTrimFromFullAnalysis(value);
+  }
+}
+
+bool PowerUserSettings::getTrimFromFullAnalysis() { return mSynth != nullptr && mSynth->getTrimFromFullAnalysis(); }
+
 SettingsComponent::SettingsComponent() {
   mBtnAnimation.setButtonText("Run animation");
   mBtnAnimation.setColour(juce::TextButton::buttonColourId, juce::Colours::red);
@@ -39,6 +63,44 @@ SettingsComponent::SettingsComponent() {
   mBtnResourceUsage.setToggleState(false, juce::NotificationType::dontSendNotification);
   mBtnResourceUsage.onClick = [this] { PowerUserSettings::get().setResourceUsage(mBtnResourceUsage.getToggleState()); };
   addAndMakeVisible(mBtnResourceUsage);
+
+  mBtnLogBlockStats.setButtonText("Log Block Stats");
+  mBtnLogBlockStats.setColour(juce::TextButton::buttonColourId, juce::Colours::red);
+  mBtnLogBlockStats.setColour(juce::TextButton::buttonOnColourId, juce::Colours::green);
+  mBtnLogBlockStats.setToggleState(PowerUserSettings::get().getLogBlockStats(), juce::NotificationType::dontSendNotification);
+  mBtnLogBlockStats.setClickingTogglesState(true);
+  mBtnLogBlockStats.onClick = [this] { PowerUserSettings::get().setLogBlockStats(mBtnLogBlockStats.getToggleState()); };
+  addAndMakeVisible(mBtnLogBlockStats);
+
+  mBtnSpectralWhitening.setButtonText("Whiten Spectrum");
+  mBtnSpectralWhitening.setColour(juce::TextButton::buttonColourId, juce::Colours::red);
+  mBtnSpectralWhitening.setColour(juce::TextButton::buttonOnColourId, juce::Colours::green);
+  mBtnSpectralWhitening.setToggleState(PowerUserSettings::get().getSpectralWhitening(),
+                                       juce::NotificationType::dontSendNotification);
+  mBtnSpectralWhitening.setClickingTogglesState(true);
+  mBtnSpectralWhitening.onClick = [this] {
+    PowerUserSettings::get().setSpectralWhitening(mBtnSpectralWhitening.getToggleState());
+  };
+  addAndMakeVisible(mBtnSpectralWhitening);
+
+  mBtnPolyphonicPitch.setButtonText("Polyphonic Pitch");
+  mBtnPolyphonicPitch.setColour(juce::TextButton::buttonColourId, juce::Colours::red);
+  mBtnPolyphonicPitch.setColour(juce::TextButton::buttonOnColourId, juce::Colours::green);
+  mBtnPolyphonicPitch.setToggleState(PowerUserSettings::get().getPolyphonicPitch(), juce::NotificationType::dontSendNotification);
+  mBtnPolyphonicPitch.setClickingTogglesState(true);
+  mBtnPolyphonicPitch.onClick = [this] { PowerUserSettings::get().setPolyphonicPitch(mBtnPolyphonicPitch.getToggleState()); };
+  addAndMakeVisible(mBtnPolyphonicPitch);
+
+  mBtnTrimFromFullAnalysis.setButtonText("Trim From Full");
+  mBtnTrimFromFullAnalysis.setColour(juce::TextButton::buttonColourId, juce::Colours::red);
+  mBtnTrimFromFullAnalysis.setColour(juce::TextButton::buttonOnColourId, juce::Colours::green);
+  mBtnTrimFromFullAnalysis.setToggleState(PowerUserSettings::get().getTrimFromFullAnalysis(),
+                                          juce::NotificationType::dontSendNotification);
+  mBtnTrimFromFullAnalysis.setClickingTogglesState(true);
+  mBtnTrimFromFullAnalysis.onClick = [this] {
+    PowerUserSettings::get().setTrimFromFullAnalysis(mBtnTrimFromFullAnalysis.getToggleState());
+  };
+  addAndMakeVisible(mBtnTrimFromFullAnalysis);
 }
 
 SettingsComponent::~SettingsComponent() {}
@@ -56,4 +118,8 @@ void SettingsComponent::resized() {
   mBtnAnimation.setBounds(r.removeFromTop(buttonHeight).withWidth(buttonWidth));
   mBtnResetParameters.setBounds(r.removeFromTop(buttonHeight).withWidth(buttonWidth));
   mBtnResourceUsage.setBounds(r.removeFromTop(buttonHeight).withWidth(buttonWidth));
+  mBtnLogBlockStats.setBounds(r.removeFromTop(buttonHeight).withWidth(buttonWidth));
+  mBtnSpectralWhitening.setBounds(r.removeFromTop(buttonHeight).withWidth(buttonWidth));
+  mBtnPolyphonicPitch.setBounds(r.removeFromTop(buttonHeight).withWidth(buttonWidth));
+  mBtnTrimFromFullAnalysis.setBounds(r.removeFromTop(buttonHeight).withWidth(buttonWidth));
 }
\ No newline at end of file
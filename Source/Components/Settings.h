@@ -19,7 +19,7 @@
 */
 class PowerUserSettings {
  public:
-  PowerUserSettings() : mIsAnimated(true), mIsResourceUsage(true), mSynth(nullptr){};
+  PowerUserSettings() : mIsAnimated(true), mIsResourceUsage(true), mIsLogBlockStats(false), mSynth(nullptr){};
   ~PowerUserSettings(){};
 
   void setSynth(GranularSynth* synth) { mSynth = synth; }
@@ -30,8 +30,22 @@ class PowerUserSettings {
   void setResourceUsage(bool value) { mIsResourceUsage = value; }
   bool getResourceUsage() { return mIsResourceUsage; }
 
+  // Writes a summary of the audio thread stats to the juce::Logger once a second
+  void setLogBlockStats(bool value) { mIsLogBlockStats = value; }
+  bool getLogBlockStats() { return mIsLogBlockStats; }
+
   void resetParameters();
 
+  // Whiten the spectrum before pitch detection, applies to the next audio file loaded
+  void setSpectralWhitening(bool value);
+  bool getSpectralWhitening();
+  // Track several concurrent pitches instead of a single melody, applies to the next audio file loaded
+  void setPolyphonicPitch(bool value);
+  bool getPolyphonicPitch();
+  // Analyze the whole file once and cut trimmed selections out of it, so trimming the same file again is fast
+  void setTrimFromFullAnalysis(bool value);
+  bool getTrimFromFullAnalysis();
+
   // Creates a singleton
   PowerUserSettings(PowerUserSettings const&) = delete;
   void operator=(PowerUserSettings const&) = delete;
@@ -43,6 +57,7 @@ class PowerUserSettings {
  private:
   bool mIsAnimated;
   bool mIsResourceUsage;
+  bool mIsLogBlockStats;
 
   GranularSynth* mSynth;
 };
@@ -59,11 +74,15 @@ class SettingsComponent : public juce::Component {
   void resized() override;
 
   // height of setting component
-  int getHeight() { return 100; }
+  int getHeight() { return 220; }
 
 private:
   const int mDivideLineSize = 5;
   juce::TextButton mBtnAnimation;
   juce::TextButton mBtnResetParameters;
   juce::TextButton mBtnResourceUsage;
+  juce::TextButton mBtnLogBlockStats;
+  juce::TextButton mBtnSpectralWhitening;
+  juce::TextButton mBtnPolyphonicPitch;
+  juce::TextButton mBtnTrimFromFullAnalysis;
 };
@@ -0,0 +1,171 @@
+/*
+  ==============================================================================
+
+    AnalysisCache.cpp
+
+  ==============================================================================
+*/
+
+#include "AnalysisCache.h"
+
+// Final mix of splitmix64, spreads every input bit over the whole word
+static inline juce::uint64 mix64(juce::uint64 x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// Two independent 64 bit lanes over 8 byte words, each lane only waits on its own multiply so it runs at memory speed
+static void hashBytes(const void* data, size_t numBytes, juce::uint64& lane1, juce::uint64& lane2) {
+  static constexpr juce::uint64 PRIME_1 = 0x9e3779b97f4a7c15ULL;
+  static constexpr juce::uint64 PRIME_2 = 0xc2b2ae3d27d4eb4fULL;
+  const char* bytes = static_cast<const char*>(data);
+  size_t i = 0;
+  for (; i + 16 <= numBytes; i += 16) {
+    juce::uint64 word1, word2;
+    std::memcpy(&word1, bytes + i, sizeof(word1));
+    std::memcpy(&word2, bytes + i + 8, sizeof(word2));
+    lane1 = (lane1 ^ word1) * PRIME_1;
+    lane2 = (lane2 ^ word2) * PRIME_2;
+  }
+  for (; i < numBytes; ++i) {
+    lane1 = (lane1 ^ static_cast<juce::uint8>(bytes[i])) * PRIME_1;
+  }
+  lane1 = mix64(lane1 ^ numBytes);
+  lane2 = mix64(lane2 ^ lane1);
+}
+
+AnalysisCache::AnalysisCache()
+    : AnalysisCache(juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                        .getChildFile("gRainbow")
+                        .getChildFile("AnalysisCache")) {}
+
+AnalysisCache::AnalysisCache(const juce::File& directory, juce::int64 maxSizeBytes)
+    : mDirectory(directory), mMaxSizeBytes(maxSizeBytes) {}
+
+juce::String AnalysisCache::getKey(const juce::AudioBuffer<float>& audioBuffer, double sampleRate,
+                                   const juce::String& analysisParams) {
+  juce::uint64 lane1 = VERSION;
+  juce::uint64 lane2 = ~juce::uint64(VERSION);
+  const juce::String settings =
+      analysisParams + juce::String::formatted(" rate %f channels %d samples %d", sampleRate, audioBuffer.getNumChannels(),
+                                               audioBuffer.getNumSamples());
+  hashBytes(settings.toRawUTF8(), settings.getNumBytesAsUTF8(), lane1, lane2);
+  for (int c = 0; c < audioBuffer.getNumChannels(); ++c) {
+    hashBytes(audioBuffer.getReadPointer(c), audioBuffer.getNumSamples() * sizeof(float), lane1, lane2);
+  }
+  return juce::String::toHexString(static_cast<juce::int64>(lane1)).paddedLeft('0', 16) +
+         juce::String::toHexString(static_cast<juce::int64>(lane2)).paddedLeft('0', 16);
+}
+
+bool AnalysisCache::readSpec(juce::InputStream& input, Utils::SpecBuffer& spec, uint32_t numFrames, uint32_t numBins) {
+  spec.setSize(numFrames, numBins);
+  const size_t numBytes = static_cast<size_t>(numFrames) * numBins * sizeof(float);
+  return numBytes == 0 || (input.read(spec.data(), static_cast<int>(numBytes)) == static_cast<int>(numBytes));
+}
+
+bool AnalysisCache::load(const juce::String& key, Utils::SpecBuffer& spectrogram, Utils::SpecBuffer& hpcp,
+                         PitchDetector::PitchMap& pitchMap) {
+  if (!mIsEnabled) return false;
+  const juce::File file = getFile(key);
+  juce::FileInputStream fileInput(file);
+  if (!fileInput.openedOk()) return false;
+  juce::GZIPDecompressorInputStream input(fileInput);
+
+  Header header;
+  if (input.read(&header, sizeof(header)) != sizeof(header) || header.magic != MAGIC || header.version != VERSION) {
+    return false;
+  }
+  // Keeps a corrupt header from asking for gigabytes, juce::InputStream::read also takes an int
+  const juce::uint64 maxFloats = std::numeric_limits<int>::max() / sizeof(float);
+  if ((juce::uint64)header.spectrogramFrames * header.spectrogramBins > maxFloats ||
+      (juce::uint64)header.hpcpFrames * header.hpcpBins > maxFloats) {
+    return false;
+  }
+  if (!readSpec(input, spectrogram, header.spectrogramFrames, header.spectrogramBins) ||
+      !readSpec(input, hpcp, header.hpcpFrames, header.hpcpBins)) {
+    return false;
+  }
+
+  pitchMap.clear();
+  for (Utils::PitchClass pitchClass : Utils::ALL_PITCH_CLASS) {
+    const int numPitches = input.readInt();
+    if (numPitches < 0 || numPitches > MAX_PITCHES_PER_CLASS || input.isExhausted()) return false;
+    std::vector<PitchDetector::Pitch>& pitchVec = pitchMap.getReference(pitchClass);
+    pitchVec.reserve(numPitches);
+    for (int i = 0; i < numPitches; ++i) {
+      const float posRatio = input.readFloat();
+      const float duration = input.readFloat();
+      const float gain = input.readFloat();
+      pitchVec.push_back(PitchDetector::Pitch(pitchClass, posRatio, duration, gain));
+    }
+  }
+  if (input.readInt() != static_cast<int>(MAGIC)) return false;  // Only a complete file ends with the magic again
+
+  // Marks the entry as recently used
+  file.setLastModificationTime(juce::Time::getCurrentTime());
+  return true;
+}
+
+void AnalysisCache::store(const juce::String& key, const Utils::SpecBuffer& spectrogram, const Utils::SpecBuffer& hpcp,
+                          PitchDetector::PitchMap& pitchMap) {
+  if (!mIsEnabled) return;
+  const juce::ScopedLock lock(mStoreLock);
+  if (!mDirectory.createDirectory()) return;
+
+  // Written next to the entry and moved into place, a crash or a reader never sees half a file
+  juce::TemporaryFile tempFile(getFile(key));
+  {
+    juce::FileOutputStream fileOutput(tempFile.getFile());
+    if (!fileOutput.openedOk()) return;
+    {
+      juce::GZIPCompressorOutputStream output(fileOutput, COMPRESSION_LEVEL);
+
+      Header header{};
+      header.magic = MAGIC;
+      header.version = VERSION;
+      header.spectrogramFrames = static_cast<uint32_t>(spectrogram.size());
+      header.spectrogramBins = static_cast<uint32_t>(spectrogram.getNumBins());
+      header.hpcpFrames = static_cast<uint32_t>(hpcp.size());
+      header.hpcpBins = static_cast<uint32_t>(hpcp.getNumBins());
+      output.write(&header, sizeof(header));
+      output.write(spectrogram.data(), spectrogram.size() * spectrogram.getNumBins() * sizeof(float));
+      output.write(hpcp.data(), hpcp.size() * hpcp.getNumBins() * sizeof(float));
+
+      for (Utils::PitchClass pitchClass : Utils::ALL_PITCH_CLASS) {
+        const std::vector<PitchDetector::Pitch>& pitchVec = pitchMap.getReference(pitchClass);
+        output.writeInt(static_cast<int>(pitchVec.size()));
+        for (const PitchDetector::Pitch& pitch : pitchVec) {
+          output.writeFloat(pitch.posRatio);
+          output.writeFloat(pitch.duration);
+          output.writeFloat(pitch.gain);
+        }
+      }
+      output.writeInt(static_cast<int>(MAGIC));
+    }
+    fileOutput.flush();
+    if (fileOutput.getStatus().failed()) return;
+  }
+  if (!tempFile.overwriteTargetFileWithTemporary()) return;
+
+  removeOldEntries();
+}
+
+void AnalysisCache::removeOldEntries() {
+  juce::Array<juce::File> entries = mDirectory.findChildFiles(juce::File::findFiles, false, juce::String("*") + FILE_EXTENSION);
+  std::sort(entries.begin(), entries.end(), [](const juce::File& self, const juce::File& other) {
+    return self.getLastModificationTime() > other.getLastModificationTime();
+  });
+
+  juce::int64 totalBytes = 0;
+  for (const juce::File& entry : entries) {
+    totalBytes += entry.getSize();
+    // Always keeps the newest, even if it alone is over the limit
+    if (totalBytes > mMaxSizeBytes && entry != entries.getFirst()) {
+      entry.deleteFile();
+    }
+  }
+}
@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    AnalysisCache.h
+
+    On disk cache of the analysis of an audio buffer (spectrogram, HPCP and
+    detected pitches) so loading a sample that was seen before skips the FFT,
+    HPCP and segmenting. Entries are keyed by a hash of the audio and the
+    analysis settings, so changing either is a miss and never stale.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "PitchDetector.h"
+#include "../Utils.h"
+
+class AnalysisCache {
+ public:
+  // ascii for 'gbac'
+  static constexpr uint32_t MAGIC = 0x67626163;
+  // Bump whenever the file layout or anything in the analysis output changes, old entries then just stop matching
+  static constexpr uint32_t VERSION = 1;
+  // Least recently used entries are removed past this
+  static constexpr juce::int64 MAX_SIZE_BYTES = 1024LL * 1024 * 1024;
+
+  AnalysisCache();
+  // Keeps the entries in directory instead of the user's application data
+  AnalysisCache(const juce::File& directory, juce::int64 maxSizeBytes = MAX_SIZE_BYTES);
+
+  // Key for the audio analyzed with the settings described by analysisParams. Fast enough to run on load, it is not a
+  // cryptographic hash
+  static juce::String getKey(const juce::AudioBuffer<float>& audioBuffer, double sampleRate, const juce::String& analysisParams);
+
+  // Returns false and leaves the outputs in an unknown state on a miss
+  bool load(const juce::String& key, Utils::SpecBuffer& spectrogram, Utils::SpecBuffer& hpcp, PitchDetector::PitchMap& pitchMap);
+  // Safe to call from the analysis thread, failures to write are ignored (it is only a cache)
+  void store(const juce::String& key, const Utils::SpecBuffer& spectrogram, const Utils::SpecBuffer& hpcp,
+             PitchDetector::PitchMap& pitchMap);
+
+  void setEnabled(bool enabled) { mIsEnabled = enabled; }
+  bool isEnabled() const { return mIsEnabled; }
+
+ private:
+  static constexpr auto FILE_EXTENSION = ".gbac";
+  static constexpr auto COMPRESSION_LEVEL = 1;  // Mostly silence that compresses well even at the fastest level
+  static constexpr auto MAX_PITCHES_PER_CLASS = 1 << 20;
+
+  typedef struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t spectrogramFrames;
+    uint32_t spectrogramBins;
+    uint32_t hpcpFrames;
+    uint32_t hpcpBins;
+    uint32_t reserved[8];
+  } Header;
+
+  juce::File getFile(const juce::String& key) const { return mDirectory.getChildFile(key + FILE_EXTENSION); }
+  static bool readSpec(juce::InputStream& input, Utils::SpecBuffer& spec, uint32_t numFrames, uint32_t numBins);
+  void removeOldEntries();
+
+  juce::File mDirectory;
+  juce::int64 mMaxSizeBytes;
+  std::atomic<bool> mIsEnabled{true};
+  juce::CriticalSection mStoreLock;  // Only one entry written (and the size limit enforced) at a time
+};
@@ -0,0 +1,66 @@
+/*
+  ==============================================================================
+
+    AnalysisThreadPool.cpp
+
+  ==============================================================================
+*/
+
+#include "AnalysisThreadPool.h"
+
+AnalysisThreadPool::AnalysisThreadPool() : mPool(juce::jmax(1, juce::SystemStats::getNumCpus())) {}
+
+AnalysisThreadPool::~AnalysisThreadPool() { mPool.removeAllJobs(true, 4000); }
+
+bool AnalysisThreadPool::parallelFor(int numItems, int chunkSize,
+                                     const std::function<void(int start, int end, int workerIdx)>& fn,
+                                     const std::function<bool()>& shouldExit,
+                                     const std::function<void(double progress)>& onProgress,
+                                     const std::function<void(int numItemsReady)>& onItemsReady) {
+  if (numItems <= 0) return !shouldExit();
+  chunkSize = juce::jmax(1, chunkSize);
+  const int numChunks = (numItems + chunkSize - 1) / chunkSize;
+  const int numWorkers = juce::jmin(numChunks, getNumWorkers());
+
+  // Owned by the jobs as well, the last worker can still be signalling when the caller returns
+  struct State {
+    std::atomic<int> nextChunk{0};
+    std::atomic<int> numItemsDone{0};
+    std::atomic<int> numWorkersDone{0};
+    std::atomic<bool> isCancelled{false};
+    juce::WaitableEvent allDone;
+    // Only tracked when someone wants the finished prefix
+    std::unique_ptr<std::atomic<bool>[]> isChunkDone;
+  };
+  auto state = std::make_shared<State>();
+  if (onItemsReady != nullptr) state->isChunkDone = std::make_unique<std::atomic<bool>[]>(numChunks);
+  int numChunksReady = 0;
+
+  for (int workerIdx = 0; workerIdx < numWorkers; ++workerIdx) {
+    mPool.addJob([state, &fn, workerIdx, numItems, chunkSize, numChunks, numWorkers]() {
+      for (int chunk = state->nextChunk++; chunk < numChunks && !state->isCancelled; chunk = state->nextChunk++) {
+        const int start = chunk * chunkSize;
+        const int end = juce::jmin(numItems, start + chunkSize);
+        fn(start, end, workerIdx);
+        state->numItemsDone += end - start;
+        if (state->isChunkDone != nullptr) state->isChunkDone[chunk] = true;
+      }
+      // fn is the only thing on the caller's stack, it is not touched after this
+      if (++state->numWorkersDone == numWorkers) state->allDone.signal();
+    });
+  }
+
+  // fn lives on the caller's stack, so even when cancelled wait for the running chunks to finish
+  while (!state->allDone.wait(PROGRESS_INTERVAL_MS)) {
+    if (shouldExit()) {
+      state->isCancelled = true;
+    } else {
+      if (onProgress != nullptr) onProgress(state->numItemsDone.load() / static_cast<double>(numItems));
+      if (onItemsReady != nullptr) {
+        while (numChunksReady < numChunks && state->isChunkDone[numChunksReady]) ++numChunksReady;
+        onItemsReady(juce::jmin(numItems, numChunksReady * chunkSize));
+      }
+    }
+  }
+  return !state->isCancelled && !shouldExit();
+}
@@ -0,0 +1,50 @@
+/*
+  ==============================================================================
+
+    AnalysisThreadPool.h
+
+    Thread pool shared by the offline analysis (FFT, HPCP) to split work over
+    frames across all cores. Hold it with a juce::SharedResourcePointer so
+    the threads only live while something that analyzes audio is alive.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+class AnalysisThreadPool {
+ public:
+  AnalysisThreadPool();
+  ~AnalysisThreadPool();
+
+  // Max number of workers a parallelFor can have, use to size per worker scratch space
+  int getNumWorkers() const { return mPool.getNumThreads(); }
+
+  /**
+   * @brief Runs fn over [0, numItems) in chunks of chunkSize and blocks until all are done. Workers keep claiming the next
+   * chunk until none are left, so a worker that gets easy chunks simply takes more of them. Chunks can finish in any order.
+   *
+   * The calling thread only waits, polling shouldExit to cancel the chunks not yet started and reporting the fraction of
+   * items done through onProgress, so all the callbacks are only ever called from the caller's thread.
+   *
+   * @param fn called as fn(start, end, workerIdx), workerIdx is unique among the chunks running at the same time
+   * @param onItemsReady called with every poll with numItemsReady, the items in [0, numItemsReady) are all done. Lets the
+   * caller start consuming results in order while later chunks still run
+   * @return false if cancelled
+   */
+  bool parallelFor(int numItems, int chunkSize, const std::function<void(int start, int end, int workerIdx)>& fn,
+                   const std::function<bool()>& shouldExit, const std::function<void(double progress)>& onProgress = nullptr,
+                   const std::function<void(int numItemsReady)>& onItemsReady = nullptr);
+
+  // Runs job once on a worker and returns right away, for single tasks that should stay off the calling thread
+  void addJob(std::function<void()> job) { mPool.addJob(std::move(job)); }
+
+ private:
+  static constexpr auto PROGRESS_INTERVAL_MS = 20;
+
+  juce::ThreadPool mPool;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisThreadPool)
+};
@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+    BlockStats.h
+
+    Per block timing and grain counts recorded on the audio thread and handed
+    to the UI (or a log) through a lock-free single producer/single consumer
+    FIFO. The audio thread never waits, if the FIFO is full the block is dropped.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+struct BlockStats {
+  int numSamples = 0;
+  double budgetMs = 0.0;  // Time the host gives us for the block
+  double blockMs = 0.0;   // Whole processBlock
+  double mixMs = 0.0;     // Grain mixing and generator envelopes
+  double filterMs = 0.0;  // Generator filters
+  double spawnMs = 0.0;   // Adding and removing grains
+  int activeVoices = 0;
+  int activeGrains = 0;
+  int grainsSpawned = 0;
+  int grainsDropped = 0;  // Grains that were due but the generator was already full
+
+  static double ticksToMs(juce::int64 ticks) { return juce::Time::highResolutionTicksToSeconds(ticks) * 1000.0; }
+
+  // Accumulates whatever was drained since the last report
+  struct Summary {
+    int numBlocks = 0;
+    double avgBlockMs = 0.0;
+    double worstBlockMs = 0.0;
+    double worstBudgetMs = 0.0;  // Budget of the worst block, the load is worstBlockMs / worstBudgetMs
+    double mixMs = 0.0;
+    double filterMs = 0.0;
+    double spawnMs = 0.0;
+    int activeVoices = 0;  // From the most recent block
+    int activeGrains = 0;
+    int grainsSpawned = 0;
+    int grainsDropped = 0;
+
+    void add(const BlockStats& stats) {
+      numBlocks++;
+      avgBlockMs += (stats.blockMs - avgBlockMs) / numBlocks;
+      if (stats.blockMs >= worstBlockMs) {
+        worstBlockMs = stats.blockMs;
+        worstBudgetMs = stats.budgetMs;
+      }
+      mixMs += stats.mixMs;
+      filterMs += stats.filterMs;
+      spawnMs += stats.spawnMs;
+      activeVoices = stats.activeVoices;
+      activeGrains = stats.activeGrains;
+      grainsSpawned += stats.grainsSpawned;
+      grainsDropped += stats.grainsDropped;
+    }
+
+    juce::String toString() const {
+      if (numBlocks == 0) return "no blocks";
+      const double totalMs = juce::jmax(mixMs + filterMs + spawnMs, 1e-9);
+      const double worstLoad = worstBudgetMs > 0.0 ? (worstBlockMs / worstBudgetMs) * 100.0 : 0.0;
+      return "block avg " + juce::String(avgBlockMs, 3) + " ms worst " + juce::String(worstBlockMs, 3) + " ms (" +
+             juce::String(worstLoad, 0) + "% of budget) | mix " + juce::String(mixMs / totalMs * 100.0, 0) + "% filter " +
+             juce::String(filterMs / totalMs * 100.0, 0) + "% spawn " + juce::String(spawnMs / totalMs * 100.0, 0) +
+             "% | voices " + juce::String(activeVoices) + " grains " + juce::String(activeGrains) + " spawned " +
+             juce::String(grainsSpawned) + " dropped " + juce::String(grainsDropped);
+    }
+  };
+};
+
+class BlockStatsFifo {
+ public:
+  static constexpr int CAPACITY = 256;  // A bit over a second of 256 sample blocks at 48k, plenty for a 50ms UI timer
+
+  // Audio thread only
+  void push(const BlockStats& stats) {
+    const auto scope = mFifo.write(1);
+    if (scope.blockSize1 > 0) {
+      mBuffer[scope.startIndex1] = stats;
+    } else {
+      mNumDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Single consumer only, returns the number of stats drained
+  int drain(BlockStats::Summary& summary) {
+    const auto scope = mFifo.read(mFifo.getNumReady());
+    for (int i = 0; i < scope.blockSize1; ++i) summary.add(mBuffer[scope.startIndex1 + i]);
+    for (int i = 0; i < scope.blockSize2; ++i) summary.add(mBuffer[scope.startIndex2 + i]);
+    return scope.blockSize1 + scope.blockSize2;
+  }
+
+  // Blocks that were not recorded because nobody was draining
+  int getNumDropped() const { return mNumDropped.load(std::memory_order_relaxed); }
+
+ private:
+  juce::AbstractFifo mFifo{CAPACITY};
+  std::array<BlockStats, CAPACITY> mBuffer;
+  std::atomic<int> mNumDropped{0};
+};
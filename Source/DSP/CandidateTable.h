@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+    CandidateTable.h
+
+    Copy of the candidates of every pitch class that the audio thread spawns
+    grains from. The analysis (or message) thread rewrites it while notes are
+    playing, so it is guarded by a sequence counter instead of a lock: the
+    reader retries if a write happened while it was copying a candidate and
+    never waits on the writer. Writers come from both the analysis and the
+    message thread, they take a lock among themselves.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "../Parameters.h"
+#include "../Utils.h"
+
+class CandidateTable {
+ public:
+  CandidateTable() { clear(); }
+
+  // Writer side, any thread but the audio thread
+  void clear() {
+    const juce::SpinLock::ScopedLockType lock(mWriteLock);
+    beginWrite();
+    for (std::atomic<int>& numCandidates : mNumCandidates) numCandidates.store(0, std::memory_order_relaxed);
+    endWrite();
+  }
+
+  void set(Utils::PitchClass pitchClass, const std::vector<ParamCandidate>& candidates) {
+    const juce::SpinLock::ScopedLockType lock(mWriteLock);
+    beginWrite();
+    const int numCandidates = juce::jmin(static_cast<int>(candidates.size()), MAX_CANDIDATES);
+    for (int i = 0; i < numCandidates; ++i) {
+      Entry& entry = mEntries[pitchClass][i];
+      entry.posRatio.store(candidates[i].posRatio, std::memory_order_relaxed);
+      entry.pbRate.store(candidates[i].pbRate, std::memory_order_relaxed);
+      entry.duration.store(candidates[i].duration, std::memory_order_relaxed);
+      entry.salience.store(candidates[i].salience, std::memory_order_relaxed);
+    }
+    mNumCandidates[pitchClass].store(numCandidates, std::memory_order_relaxed);
+    endWrite();
+  }
+
+  // Reader side, safe from the audio thread
+  int getNumCandidates(Utils::PitchClass pitchClass) const { return mNumCandidates[pitchClass].load(std::memory_order_relaxed); }
+
+  // Returns false if there is no such candidate, or (rarely) if it kept changing while being read
+  bool get(Utils::PitchClass pitchClass, int idx, ParamCandidate& candidate) const {
+    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt) {
+      const juce::uint32 sequence = mSequence.load(std::memory_order_acquire);
+      if (sequence & 1) continue;  // Write in progress
+      if (idx < 0 || idx >= mNumCandidates[pitchClass].load(std::memory_order_relaxed)) return false;
+      const Entry& entry = mEntries[pitchClass][idx];
+      candidate.posRatio = entry.posRatio.load(std::memory_order_relaxed);
+      candidate.pbRate = entry.pbRate.load(std::memory_order_relaxed);
+      candidate.duration = entry.duration.load(std::memory_order_relaxed);
+      candidate.salience = entry.salience.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (mSequence.load(std::memory_order_relaxed) == sequence) return true;
+    }
+    return false;
+  }
+
+ private:
+  // A grain skipped now and then is better than the audio thread spinning on a busy writer
+  static constexpr auto MAX_READ_ATTEMPTS = 4;
+
+  typedef struct Entry {
+    std::atomic<float> posRatio{0.0f};
+    std::atomic<float> pbRate{1.0f};
+    std::atomic<float> duration{0.0f};
+    std::atomic<float> salience{0.0f};
+  } Entry;
+
+  void beginWrite() {
+    mSequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  void endWrite() { mSequence.fetch_add(1, std::memory_order_release); }
+
+  juce::SpinLock mWriteLock;               // Two writers at once would leave the sequence even mid write
+  std::atomic<juce::uint32> mSequence{0};  // Odd while a write is in progress
+  std::array<std::array<Entry, MAX_CANDIDATES>, Utils::PitchClass::COUNT> mEntries;
+  std::array<std::atomic<int>, Utils::PitchClass::COUNT> mNumCandidates;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CandidateTable)
+};
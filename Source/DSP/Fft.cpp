@@ -18,7 +18,9 @@ Fft::Fft(int windowSize, int hopSize, double startProgress, double endProgress)
       mDiffProgress(mEndProgress - mStartProgress),
       mForwardFFT(std::log2(windowSize)),
       mWindowEnvelope(windowSize, juce::dsp::WindowingFunction<float>::WindowingMethod::blackmanHarris),
-      juce::Thread("fft thread") {}
+      juce::Thread("fft thread") {
+  mFftScratch.resize(static_cast<size_t>(mThreadPool->getNumWorkers()) * mWindowSize * 2, 0.0f);
+}
 
 Fft::~Fft() {}
 
@@ -26,44 +28,47 @@ Fft::~Fft() {}
 // notify when done
 void Fft::run() {
   if (mInputBuffer == nullptr) return;
-  clear(true);
   // Runs with first channel
   const int numInputSamples = mInputBuffer->getNumSamples();
   const float* pBuffer = mInputBuffer->getReadPointer(0);
-  mFftFrame.resize(mWindowSize * 2, 0.0f);
-  int curSample = 0;
-  bool hasData = numInputSamples > mFftFrame.size();
-  float curMax = std::numeric_limits<float>::min();
 
-  while (hasData && !threadShouldExit()) {
-    updateProgress(mStartProgress + (mDiffProgress * (static_cast<double>(curSample) / static_cast<double>(numInputSamples))));
-    const float* startSample = &pBuffer[curSample];
-    int numSamples = mFftFrame.size();
-    if (curSample + mFftFrame.size() > numInputSamples) {
-      numSamples = (numInputSamples - curSample);
-    }
-    mFftFrame.clear();
-    mFftFrame.resize(mWindowSize * 2, 0.0f);
-    memcpy(mFftFrame.data(), startSample, numSamples);
-    mWindowEnvelope.multiplyWithWindowingTable(mFftFrame.data(), mFftFrame.size());
+  // A frame starts every hop up to and including the last sample, the tail of the last frames is zero padded
+  const int numFrames = (numInputSamples > mWindowSize * 2) ? (numInputSamples / mHopSize) + 1 : 0;
+  const int numBins = mWindowSize / 2;
+  mFftData.setSize(numFrames, numBins);
+
+  // Frames are independent, each worker transforms its chunks in its own scratch space straight into the spectrum
+  const int frameSize = mWindowSize * 2;
+  const bool isComplete = mThreadPool->parallelFor(
+      numFrames, FRAMES_PER_CHUNK,
+      [&](int startFrame, int endFrame, int workerIdx) {
+        float* fftFrame = mFftScratch.data() + (workerIdx * frameSize);
+        for (int frame = startFrame; frame < endFrame; ++frame) {
+          const int curSample = frame * mHopSize;
+          const int numSamples = juce::jmin(mWindowSize, numInputSamples - curSample);
+          juce::FloatVectorOperations::copy(fftFrame, &pBuffer[curSample], numSamples);
+          juce::FloatVectorOperations::clear(fftFrame + numSamples, frameSize - numSamples);
+          mWindowEnvelope.multiplyWithWindowingTable(fftFrame, mWindowSize);
 
-    // then render our FFT data..
-    mForwardFFT.performFrequencyOnlyForwardTransform(mFftFrame.data());
+          // then render our FFT data..
+          mForwardFFT.performFrequencyOnlyForwardTransform(fftFrame);
 
-    // Add fft data to our master array
-    std::vector<float> newFrame = std::vector<float>(mFftFrame.begin(), mFftFrame.begin() + (mWindowSize / 2));
-    float frameMax = juce::FloatVectorOperations::findMaximum(mFftFrame.data(), mFftFrame.size());
-    if (frameMax > curMax) curMax = frameMax;
-    mFftData.push_back(newFrame);
-    // Normalize fft values according to max frame value
-    for (size_t i = 0; i < mFftData.back().size(); ++i) {
-      mFftData.back()[i] /= curMax;
-    }
+          std::span<float> magnitudes = mFftData[frame];
+          juce::FloatVectorOperations::copy(magnitudes.data(), fftFrame, numBins);
+          if (onFrameReady != nullptr) {
+            onFrameReady(frame, magnitudes);
+          }
+        }
+      },
+      [this]() { return threadShouldExit(); },
+      [this](double progress) { updateProgress(mStartProgress + (mDiffProgress * progress)); });
+  if (!isComplete) return;
 
-    curSample += mHopSize;
-    if (curSample > numInputSamples) {
-      hasData = false;
-    }
+  // Normalize against the loudest bin of the whole clip so every frame shares the same scale
+  const int numValues = numFrames * numBins;
+  const float maxValue = (numValues > 0) ? juce::FloatVectorOperations::findMaximum(mFftData.data(), numValues) : 0.0f;
+  if (maxValue > 0.0f) {
+    juce::FloatVectorOperations::multiply(mFftData.data(), 1.0f / maxValue, numValues);
   }
 
   if (onProcessingComplete != nullptr) {
@@ -72,11 +77,9 @@ void Fft::run() {
 }
 
 void Fft::clear(bool clearData) {
-  mFftFrame.clear();
   if (clearData) {
     // The FFT can take up a lot of memory, need to not just clear, but have STD deallocate it
-    mFftData.clear();
-    mFftData.shrink_to_fit();
+    mFftData.release();
   }
 }
 
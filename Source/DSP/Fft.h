@@ -15,6 +15,7 @@
 #include <juce_core/juce_core.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_dsp/juce_dsp.h>
+#include "AnalysisThreadPool.h"
 #include "../Utils.h"
 
 class Fft : public juce::Thread {
@@ -31,8 +32,15 @@ class Fft : public juce::Thread {
 
   std::function<void(Utils::SpecBuffer& spectrum)> onProcessingComplete = nullptr;
   std::function<void(double progress)> onProgressUpdated = nullptr;
+  // Called once for each frame as soon as it is computed, before the spectrum is normalized so the magnitudes are raw. Frames are
+  // split across the analysis pool, so this is called from several pool threads at once and in no particular order. It must
+  // be thread safe, only touch data of its own frame and not block, the span is only valid during the call. Set it before
+  // process(), every call has returned by the time onProcessingComplete is called
+  std::function<void(int frame, std::span<const float> magnitudes)> onFrameReady = nullptr;
 
  private:
+  static constexpr auto FRAMES_PER_CHUNK = 64;  // Frames handed to a pool worker at a time
+
   // values passed in at creation time
   int mWindowSize;
   int mHopSize;
@@ -48,7 +56,9 @@ class Fft : public juce::Thread {
   double mEndProgress;
   double mDiffProgress;
 
+  juce::SharedResourcePointer<AnalysisThreadPool> mThreadPool;
+
   // processed data
-  std::vector<float> mFftFrame;
-  Utils::SpecBuffer mFftData;  // FFT data normalized from 0.0-1.0
+  std::vector<float> mFftScratch;  // space for a single transform per pool worker, sized once for the window
+  Utils::SpecBuffer mFftData;      // FFT data normalized from 0.0-1.0
 };
\ No newline at end of file
@@ -10,25 +10,171 @@
 
 #include "Grain.h"
 
-float Grain::process(const juce::AudioBuffer<float>& audioBuffer, float gain, int time) {
-  float timePerc = (time - trigTs) / (float)duration;
-  float totalGain = gain * getAmplitude(timePerc);
-  const float* const* fileBuf = audioBuffer.getArrayOfReadPointers();
-
-  float unStretchedDuration = duration * pbRate;
-  int lowSample = std::floor(juce::jmax(0.0f, timePerc * unStretchedDuration));
-  int highSample = std::ceil(juce::jmax(0.0f, timePerc * unStretchedDuration));
-  float rem = (timePerc * unStretchedDuration) - lowSample;
-
-  float sample = juce::jmap(rem, fileBuf[0][(startPos + lowSample) % audioBuffer.getNumSamples()],
-                            fileBuf[0][(startPos + highSample) % audioBuffer.getNumSamples()]);
-  sample *= totalGain;
-  return sample;
+void GrainBank::process(const juce::AudioBuffer<float>& audioBuffer, float* outLeft, float* outRight, int numSamples,
+                        Utils::InterpolationType interpolation) {
+  if (mNumGrains == 0) return;
+  const float* fileLeft = audioBuffer.getReadPointer(0);
+  const float* fileRight = (audioBuffer.getNumChannels() > 1) ? audioBuffer.getReadPointer(1) : nullptr;
+  const int fileNumSamples = audioBuffer.getNumSamples();
+  switch (interpolation) {
+    case Utils::InterpolationType::HERMITE:
+      processGrains<Utils::InterpolationType::HERMITE>(fileLeft, fileRight, fileNumSamples, outLeft, outRight, numSamples);
+      break;
+    case Utils::InterpolationType::SINC:
+      processGrains<Utils::InterpolationType::SINC>(fileLeft, fileRight, fileNumSamples, outLeft, outRight, numSamples);
+      break;
+    default:
+      processGrains<Utils::InterpolationType::LINEAR>(fileLeft, fileRight, fileNumSamples, outLeft, outRight, numSamples);
+      break;
+  }
 }
 
-float Grain::getAmplitude(float timePerc) {
-  if (mEnv.size() == 0) return 0.0f;
-  timePerc = juce::jlimit(0.0f, 1.0f, timePerc);
-  int i = timePerc * (mEnv.size() - 1);
-  return mEnv[i];
-}
\ No newline at end of file
+// Samples each kernel reads around the read position. Sinc is summed while reading, its result is passed on as the only tap
+template <Utils::InterpolationType interpolation>
+static constexpr int NUM_TAPS = (interpolation == Utils::InterpolationType::HERMITE) ? 4
+                                : (interpolation == Utils::InterpolationType::LINEAR) ? 2
+                                                                                       : 1;
+template <Utils::InterpolationType interpolation>
+static constexpr int FIRST_TAP = (interpolation == Utils::InterpolationType::HERMITE) ? -1 : 0;
+
+// T is a float for a single sample or a juce::dsp::SIMDRegister<float> for a register of them
+template <Utils::InterpolationType interpolation, typename T>
+static inline T interpolateTaps(const T* taps, T frac) {
+  if constexpr (interpolation == Utils::InterpolationType::SINC) {
+    return taps[0];
+  } else if constexpr (interpolation == Utils::InterpolationType::HERMITE) {
+    return Interpolation::hermite(taps[0], taps[1], taps[2], taps[3], frac);
+  } else {
+    return Interpolation::lerp(taps[0], taps[1], frac);
+  }
+}
+
+template <Utils::InterpolationType interpolation>
+void GrainBank::processGrains(const float* fileLeft, const float* fileRight, int fileNumSamples, float* outLeft,
+                              float* outRight, int numSamples) {
+  const bool isStereo = fileRight != nullptr;
+  const Interpolation::DirectReader directLeft{fileLeft};
+  const Interpolation::WrappedReader wrappedLeft{fileLeft, fileNumSamples};
+  const Interpolation::DirectReader directRight{isStereo ? fileRight : fileLeft};
+  const Interpolation::WrappedReader wrappedRight{isStereo ? fileRight : fileLeft, fileNumSamples};
+
+  alignas(ALIGNMENT) float mixLeft[CHUNK_SIZE];
+  alignas(ALIGNMENT) float mixRight[CHUNK_SIZE];
+
+  for (int chunkStart = 0; chunkStart < numSamples; chunkStart += CHUNK_SIZE) {
+    const int chunkSize = juce::jmin(CHUNK_SIZE, numSamples - chunkStart);
+    juce::FloatVectorOperations::clear(mixLeft, CHUNK_SIZE);
+    juce::FloatVectorOperations::clear(mixRight, CHUNK_SIZE);
+    for (int k = 0; k < mNumGrains; ++k) {
+      // A grain added partway into the block stays silent until its trigger sample
+      const int startOffset = juce::jmin(mStartDelay[k], chunkSize);
+      mStartDelay[k] -= startOffset;
+      const int grainSamples = juce::jmin(mSamplesLeft[k], chunkSize - startOffset);
+      if (grainSamples <= 0) continue;
+      // Only grains reading past an edge of the file have to wrap their indexes
+      const int firstIdx = mStartPos[k] + static_cast<int>(mRate[k] * mSamplesPlayed[k]) - Interpolation::TAPS_BEFORE;
+      const int lastIdx =
+          mStartPos[k] + static_cast<int>(mRate[k] * (mSamplesPlayed[k] + grainSamples)) + Interpolation::TAPS_AFTER;
+      if (firstIdx >= 0 && lastIdx < fileNumSamples) {
+        mixGrain<interpolation>(k, directLeft, directRight, isStereo, startOffset, grainSamples, mixLeft, mixRight);
+      } else {
+        mixGrain<interpolation>(k, wrappedLeft, wrappedRight, isStereo, startOffset, grainSamples, mixLeft, mixRight);
+      }
+      mSamplesLeft[k] -= grainSamples;
+    }
+    juce::FloatVectorOperations::add(outLeft + chunkStart, mixLeft, chunkSize);
+    juce::FloatVectorOperations::add(outRight + chunkStart, mixRight, chunkSize);
+  }
+}
+
+template <Utils::InterpolationType interpolation, typename Reader>
+void GrainBank::mixGrain(int k, const Reader& readLeft, const Reader& readRight, bool isStereo, int startOffset,
+                         int numSamples, float* mixLeft, float* mixRight) {
+  constexpr int numTaps = NUM_TAPS<interpolation>;
+  constexpr int firstTap = FIRST_TAP<interpolation>;
+  const int played = mSamplesPlayed[k];
+  const float rate = mRate[k];
+  const float envInc = mEnvInc[k];
+  const float* envTable = mEnv[k];
+  const int envLastIdx = mEnvLastIdx[k];
+  const int startPos = mStartPos[k];
+  const int sincBand = mSincBand[k];
+
+  // Everything for the chunk is gathered before any of it is loaded into registers, writing lanes one at a time right before
+  // loading the register they are in stalls on store forwarding
+  alignas(ALIGNMENT) int idx[CHUNK_SIZE];
+  alignas(ALIGNMENT) int envIdx[CHUNK_SIZE];
+  alignas(ALIGNMENT) float frac[CHUNK_SIZE];
+  alignas(ALIGNMENT) float env[CHUNK_SIZE];
+  alignas(ALIGNMENT) float tapsLeft[numTaps][CHUNK_SIZE];
+  alignas(ALIGNMENT) float tapsRight[numTaps][CHUNK_SIZE];
+
+  // Read positions come from how far into the grain each sample is instead of a phase carried from the sample before, so there
+  // is no dependency between iterations and the loop vectorizes. It also keeps rounding from adding up over a long grain
+  const int endSample = startOffset + numSamples;
+  for (int i = startOffset; i < endSample; ++i) {
+    const float grainPos = static_cast<float>(played + i - startOffset);
+    const float phase = rate * grainPos;
+    const int offset = static_cast<int>(phase);
+    idx[i] = startPos + offset;
+    frac[i] = phase - offset;
+    envIdx[i] = juce::jmin(envLastIdx, static_cast<int>(envInc * grainPos));
+  }
+  mSamplesPlayed[k] = played + numSamples;
+
+  // With every index known up front the loads don't wait on any arithmetic, with a DirectReader they are plain indexed loads
+  for (int i = startOffset; i < endSample; ++i) {
+    env[i] = envTable[envIdx[i]];
+    if constexpr (interpolation == Utils::InterpolationType::SINC) {
+      tapsLeft[0][i] = Interpolation::sinc(readLeft, idx[i], frac[i], sincBand);
+      if (isStereo) tapsRight[0][i] = Interpolation::sinc(readRight, idx[i], frac[i], sincBand);
+    } else {
+      for (int t = 0; t < numTaps; ++t) {
+        tapsLeft[t][i] = readLeft(idx[i] + firstTap + t);
+        if (isStereo) tapsRight[t][i] = readRight(idx[i] + firstTap + t);
+      }
+    }
+  }
+  // Before the start and past the end of the grain up to a whole register, adds silence
+  const int firstPadded = (startOffset / LANES) * LANES;
+  const int endPadded = ((endSample + LANES - 1) / LANES) * LANES;
+  const auto addSilence = [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      frac[i] = env[i] = 0.0f;
+      for (int t = 0; t < numTaps; ++t) tapsLeft[t][i] = tapsRight[t][i] = 0.0f;
+    }
+  };
+  addSilence(firstPadded, startOffset);
+  addSilence(endSample, endPadded);
+
+  // Everything after is done a full register at a time
+  for (int i = firstPadded; i < endPadded; i += LANES) {
+#if JUCE_USE_SIMD
+    Vec taps[numTaps];
+    const Vec fracVec = Vec::fromRawArray(frac + i);
+    const Vec envVec = Vec::fromRawArray(env + i);
+    for (int t = 0; t < numTaps; ++t) taps[t] = Vec::fromRawArray(tapsLeft[t] + i);
+    const Vec left = interpolateTaps<interpolation>(taps, fracVec) * envVec;
+    Vec right = left;
+    if (isStereo) {
+      for (int t = 0; t < numTaps; ++t) taps[t] = Vec::fromRawArray(tapsRight[t] + i);
+      right = interpolateTaps<interpolation>(taps, fracVec) * envVec;
+    }
+    (Vec::fromRawArray(mixLeft + i) + left * mGainLeft[k]).copyToRawArray(mixLeft + i);
+    (Vec::fromRawArray(mixRight + i) + right * mGainRight[k]).copyToRawArray(mixRight + i);
+#else
+    for (int j = i; j < i + LANES; ++j) {
+      float taps[numTaps];
+      for (int t = 0; t < numTaps; ++t) taps[t] = tapsLeft[t][j];
+      const float left = interpolateTaps<interpolation>(taps, frac[j]) * env[j];
+      float right = left;
+      if (isStereo) {
+        for (int t = 0; t < numTaps; ++t) taps[t] = tapsRight[t][j];
+        right = interpolateTaps<interpolation>(taps, frac[j]) * env[j];
+      }
+      mixLeft[j] += left * mGainLeft[k];
+      mixRight[j] += right * mGainRight[k];
+    }
+#endif
+  }
+}
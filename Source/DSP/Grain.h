@@ -10,25 +10,118 @@
 
 #pragma once
 #include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+#include "Interpolation.h"
 #include "../Utils.h"
 
-class Grain {
+/**
+ * @brief All the grains of a single generator stored as a structure of arrays. The mixing kernel takes one grain at a time and
+ * interpolates a full SIMD register worth of its output samples at once, adding them straight into a chunk of the output so there
+ * is no horizontal sum. Grains are kept packed at the front of the arrays, removing one swaps the last grain into its slot.
+ */
+class GrainBank {
  public:
-  Grain() : duration(0), pbRate(1.0), startPos(0), trigTs(0), gain(0.0) {}
-  Grain(std::vector<float> env, int duration, float pbRate, int startPos, int trigTs, float gain)
-      : mEnv(env), duration(duration), pbRate(pbRate), startPos(startPos), trigTs(trigTs), gain(gain) {}
-  ~Grain() {}
+  static constexpr int MAX_GRAINS = 20;  // Max grains active at once
+#if JUCE_USE_SIMD
+  using Vec = juce::dsp::SIMDRegister<float>;
+  static constexpr int LANES = static_cast<int>(Vec::SIMDNumElements);
+  static constexpr size_t ALIGNMENT = Vec::SIMDRegisterSize;
+#else
+  static constexpr int LANES = 4;
+  static constexpr size_t ALIGNMENT = 16;
+#endif
+  static constexpr int CAPACITY = MAX_GRAINS;
 
-  float process(const juce::AudioBuffer<float>& audioBuffer, float gain, int time);
+  GrainBank() { clear(); }
 
-  float getAmplitude(float timePerc);
+  void clear() {
+    mNumGrains = 0;
+    // Unused slots are never read, zeroed only so they are never garbage
+    mRate.fill(0.0f);
+    mEnvInc.fill(0.0f);
+    mGainLeft.fill(0.0f);
+    mGainRight.fill(0.0f);
+    mStartPos.fill(0);
+    mSamplesLeft.fill(0);
+    mSamplesPlayed.fill(0);
+    mStartDelay.fill(0);
+    mEnvLastIdx.fill(0);
+    mSincBand.fill(0);
+    mEnv.fill(nullptr);
+  }
+  int size() const { return mNumGrains; }
+  bool isFull() const { return mNumGrains >= MAX_GRAINS; }
 
-  const int duration;  // Grain duration in samples
-  const int startPos;  // Start position in file to play from in samples
-  const int trigTs;    // Timestamp when grain was triggered in samples
-  const float pbRate;  // Playback rate (1.0 being regular speed)
-  const float gain;    // Grain gain
+  // The envelope is not copied, it needs to outlive the grain. The grain starts playing startDelay samples into the next block
+  // that is processed. Pan goes from -1 (left) to 1 (right)
+  void add(const float* env, int envSize, int duration, float pbRate, int startPos, int fileNumSamples, float pan,
+           int startDelay = 0) {
+    jassert(!isFull() && envSize > 0 && fileNumSamples > 0);
+    const int i = mNumGrains++;
+    mStartPos[i] = ((startPos % fileNumSamples) + fileNumSamples) % fileNumSamples;  // spray can push it out of the file
+    mRate[i] = pbRate;
+    mEnvInc[i] = (envSize - 1) / (float)juce::jmax(1, duration);
+    mEnv[i] = env;
+    mEnvLastIdx[i] = envSize - 1;
+    mSincBand[i] = Interpolation::SincTable::getBand(pbRate);
+    // Constant power pan law, scaled so a centered grain keeps unity gain on both channels
+    const float panAngle = (juce::jlimit(-1.0f, 1.0f, pan) + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+    mGainLeft[i] = juce::MathConstants<float>::sqrt2 * std::cos(panAngle);
+    mGainRight[i] = juce::MathConstants<float>::sqrt2 * std::sin(panAngle);
+    mSamplesLeft[i] = duration + 1;  // A grain plays from its trigger to duration (inclusive)
+    mSamplesPlayed[i] = 0;
+    mStartDelay[i] = juce::jmax(0, startDelay);
+  }
+
+  // Removes grains that finished playing
+  void removeFinished() {
+    for (int i = mNumGrains - 1; i >= 0; --i) {
+      if (mSamplesLeft[i] <= 0) {
+        const int last = --mNumGrains;
+        mStartPos[i] = mStartPos[last];
+        mRate[i] = mRate[last];
+        mEnvInc[i] = mEnvInc[last];
+        mGainLeft[i] = mGainLeft[last];
+        mGainRight[i] = mGainRight[last];
+        mEnv[i] = mEnv[last];
+        mEnvLastIdx[i] = mEnvLastIdx[last];
+        mSincBand[i] = mSincBand[last];
+        mSamplesLeft[i] = mSamplesLeft[last];
+        mSamplesPlayed[i] = mSamplesPlayed[last];
+        mStartDelay[i] = mStartDelay[last];
+        mSamplesLeft[last] = 0;
+      }
+    }
+  }
+
+  // Adds all the grains for numSamples into the left and right buffers. A mono source is read into both channels
+  void process(const juce::AudioBuffer<float>& audioBuffer, float* outLeft, float* outRight, int numSamples,
+               Utils::InterpolationType interpolation);
 
  private:
-  std::vector<float> mEnv;
-};
\ No newline at end of file
+  int mNumGrains = 0;
+  alignas(ALIGNMENT) std::array<float, CAPACITY> mRate;      // Playback rate (1.0 being regular speed)
+  alignas(ALIGNMENT) std::array<float, CAPACITY> mEnvInc;    // Envelope table step per output sample
+  alignas(ALIGNMENT) std::array<float, CAPACITY> mGainLeft;  // Pan gains, only computed when the grain is added
+  alignas(ALIGNMENT) std::array<float, CAPACITY> mGainRight;
+  std::array<int, CAPACITY> mStartPos;                       // Start position in file to play from in samples
+  std::array<int, CAPACITY> mSamplesLeft;                    // Zero once the grain is done (and for unused lanes)
+  std::array<int, CAPACITY> mSamplesPlayed;                  // Output samples since the grain started, its read position
+  std::array<int, CAPACITY> mStartDelay;                     // Silent samples before the grain starts playing
+  std::array<int, CAPACITY> mEnvLastIdx;
+  std::array<int, CAPACITY> mSincBand;  // Sinc table band for the playback rate
+  std::array<const float*, CAPACITY> mEnv;
+
+  // Output samples mixed per pass over the grains, small enough for the mix to stay in L1
+  static constexpr int CHUNK_SIZE = 64;
+  static_assert(CHUNK_SIZE % LANES == 0, "The kernel writes whole registers into the chunk");
+
+  template <Utils::InterpolationType interpolation>
+  void processGrains(const float* fileLeft, const float* fileRight, int fileNumSamples, float* outLeft, float* outRight,
+                     int numSamples);
+  // Adds numSamples of grain k into the chunk mix from startOffset (widened to whole registers with the extra samples silent)
+  // and advances it
+  template <Utils::InterpolationType interpolation, typename Reader>
+  void mixGrain(int k, const Reader& readLeft, const Reader& readRight, bool isStereo, int startOffset, int numSamples,
+                float* mixLeft, float* mixRight);
+};
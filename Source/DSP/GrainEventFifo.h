@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    GrainEventFifo.h
+
+    Grains spawned on the audio thread, handed to the arc spectrogram through a
+    lock-free single producer/single consumer FIFO that the UI drains once per
+    frame. Each event carries everything about the grain the UI draws, so it
+    never reads the candidates the audio thread is using.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "../Utils.h"
+
+struct GrainEvent {
+  Utils::PitchClass pitchClass;
+  int genIdx;
+  float durationSec;  // How long the grain plays for, after the playback rate
+  float envGain;
+  // Candidate the grain was taken from and the generator adjustments it was played with
+  float posRatio;
+  float duration;
+  float pbRate;
+  float posAdjust;
+  float pitchAdjust;
+};
+
+class GrainEventFifo {
+ public:
+  // Every generator of every note spawning at the fastest rate still fits a few frames of events
+  static constexpr int CAPACITY = 2048;
+
+  // Audio thread only
+  void push(const GrainEvent& event) {
+    const auto scope = mFifo.write(1);
+    if (scope.blockSize1 > 0) {
+      mBuffer[scope.startIndex1] = event;
+    } else {
+      mNumDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Single consumer only, calls onEvent for each event in the order pushed and returns the number drained
+  template <typename Callback>
+  int drain(Callback&& onEvent) {
+    const auto scope = mFifo.read(mFifo.getNumReady());
+    for (int i = 0; i < scope.blockSize1; ++i) onEvent(mBuffer[scope.startIndex1 + i]);
+    for (int i = 0; i < scope.blockSize2; ++i) onEvent(mBuffer[scope.startIndex2 + i]);
+    return scope.blockSize1 + scope.blockSize2;
+  }
+
+  // Events that were not recorded because nobody was draining
+  int getNumDropped() const { return mNumDropped.load(std::memory_order_relaxed); }
+
+ private:
+  juce::AbstractFifo mFifo{CAPACITY};
+  std::array<GrainEvent, CAPACITY> mBuffer;
+  std::atomic<int> mNumDropped{0};
+};
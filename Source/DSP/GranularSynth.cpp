@@ -13,8 +13,18 @@
 #include "GranularSynth.h"
 
 #include "../PluginEditor.h"
+#include "../Preset.h"
 #include "../Components/Settings.h"
 
+// Scales the whole buffer so the loudest bin is 1.0
+static void normalizeSpec(Utils::SpecBuffer& spec) {
+  const int numValues = static_cast<int>(spec.size() * spec.getNumBins());
+  const float maxValue = (numValues > 0) ? juce::FloatVectorOperations::findMaximum(spec.data(), numValues) : 0.0f;
+  if (maxValue > 0.0f) {
+    juce::FloatVectorOperations::multiply(spec.data(), 1.0f / maxValue, numValues);
+  }
+}
+
 GranularSynth::GranularSynth()
 #ifndef JucePlugin_PreferredChannelConfigurations
     : AudioProcessor(BusesProperties()
@@ -27,38 +37,66 @@ GranularSynth::GranularSynth()
                          )
 #endif
       ,
-      // only care about tracking the processing of the DSP, not the spectrogram
-      mFft(FFT_SIZE, HOP_SIZE, 0, 0),
       mPitchDetector(0.01, 1.0) {
   mParameters.note.addParams(*this);
   mParameters.global.addParams(*this);
+  mParameters.listenToAllParams(*this);
 
   mTotalSamps = 0;
   mProcessedSpecs.fill(nullptr);
 
   mKeyboardState.addListener(this);
 
-  mFft.onProcessingComplete = [this](Utils::SpecBuffer& spectrum) {
-    mProcessedSpecs[ParamUI::SpecType::SPECTROGRAM] = &spectrum;
-    mFft.clear(false);
+  mPitchDetector.onSpectrumReady = [this](const Utils::SpecBuffer& spectrum) {
+    mSpectrogram.setDecimated(spectrum, SPECTROGRAM_FRAME_STEP);
+    // The skipped frames may have held the peak, rescale so the spectrogram still reaches 1.0
+    normalizeSpec(mSpectrogram);
+    mProcessedSpecs[ParamUI::SpecType::SPECTROGRAM] = &mSpectrogram;
   };
 
   mPitchDetector.onHarmonicProfileReady = [this](Utils::SpecBuffer& hpcpBuffer) {
-    mProcessedSpecs[ParamUI::SpecType::HPCP] = &hpcpBuffer;
+    mAnalysisHpcp = &hpcpBuffer;
+    if (mTrimFrames.isEmpty()) {
+      mProcessedSpecs[ParamUI::SpecType::HPCP] = &hpcpBuffer;
+    } else {
+      mHpcpCopy.setSlice(hpcpBuffer, mTrimFrames.getStart(), mTrimFrames.getLength());
+      mProcessedSpecs[ParamUI::SpecType::HPCP] = &mHpcpCopy;
+    }
+  };
+
+  // Only the grains see these, the note params (and the UI) get the candidates once the analysis is done
+  mPitchDetector.onPartialPitchesReady = [this](PitchDetector::PitchMap& pitchMap) {
+    for (auto&& note : mParameters.note.notes) {
+      mPartialCandidates.clear();
+      findCandidates(pitchMap, note->noteIdx, mPartialCandidates);
+      mCandidateTable.set((Utils::PitchClass)note->noteIdx, mPartialCandidates);
+    }
   };
 
   mPitchDetector.onPitchesReady = [this](PitchDetector::PitchMap& pitchMap, Utils::SpecBuffer& pitchSpec) {
     mProcessedSpecs[ParamUI::SpecType::DETECTED] = &pitchSpec;
     createCandidates(pitchMap);
+    // Generators go back to their selected candidate
+    mLoadingProgress = 1.0;
+    // Still on the detector thread, loading another file waits in cancelProcessing() until this is written
+    if (mShouldStoreAnalysis && mAnalysisHpcp != nullptr) {
+      mAnalysisCache.store(mAnalysisKey, mSpectrogram, *mAnalysisHpcp, pitchMap);
+    }
     mPitchDetector.clear();
   };
 
-  mPitchDetector.onProgressUpdated = [this](float progress) { mLoadingProgress = progress; };
+  // The detector reports it is done before the candidates are created, that is left to onPitchesReady
+  mPitchDetector.onProgressUpdated = [this](float progress) { mLoadingProgress = juce::jmin(progress, 0.99f); };
 
+  // Nothing being loaded yet
+  mAnalysisLoaded.signal();
   resetParameters();
 }
 
-GranularSynth::~GranularSynth() {}
+GranularSynth::~GranularSynth() {
+  // The cache lookup job uses this synth
+  mAnalysisLoaded.wait();
+}
 
 //==============================================================================
 const juce::String GranularSynth::getName() const { return JucePlugin_Name; }
@@ -108,12 +146,16 @@ void GranularSynth::changeProgramName(int index, const juce::String& newName) {}
 //==============================================================================
 void GranularSynth::prepareToPlay(double sampleRate, int samplesPerBlock) {
   mSampleRate = sampleRate;
+  mMaxBlockSize = juce::jmax(1, samplesPerBlock);
+  mGenBuffer.setSize(GenBufferChannel::COUNT, mMaxBlockSize);
   for (auto&& note : mParameters.note.notes) {
     for (auto&& gen : note->generators) {
-      gen->filter.prepare({sampleRate, (juce::uint32)samplesPerBlock, 1});
+      gen->filter.prepare({sampleRate, (juce::uint32)samplesPerBlock, 2});
       gen->sampleRate = sampleRate;
     }
   }
+  // prepare() cleared the filters
+  for (auto& isFilterRinging : mIsFilterRinging) isFilterRinging.fill(false);
 }
 
 void GranularSynth::releaseResources() {
@@ -127,8 +169,7 @@ bool GranularSynth::isBusesLayoutSupported(const BusesLayout& layouts) const {
   juce::ignoreUnused(layouts);
   return true;
 #else
-  // This is the place where you check if the layout is supported.
-  // In this template code we only support mono or stereo.
+  // Grains are rendered in stereo, mono gets a downmix
   if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono() &&
       layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
     return false;
@@ -148,8 +189,17 @@ void GranularSynth::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuf
   auto totalNumInputChannels = getTotalNumInputChannels();
   auto totalNumOutputChannels = getTotalNumOutputChannels();
   const int bufferNumSample = buffer.getNumSamples();
+  const juce::int64 blockStartTicks = juce::Time::getHighResolutionTicks();
+  mBlockStats = BlockStats();
+  mBlockStats.numSamples = bufferNumSample;
+  mBlockStats.budgetMs = (bufferNumSample / mSampleRate) * 1000.0;
+
+  // Only resolve the parameter hierarchy again if something changed since the last block
+  if (mParameters.snapshotDirty.load()) {
+    mParameters.updateSnapshot();
+  }
 
-  mKeyboardState.processNextMidiBuffer(midiMessages, 0, bufferNumSample, true);
+  handleKeyboardNotes();
 
   // In case we have more outputs than inputs, this code clears any output
   // channels that didn't contain input data, (because these aren't
@@ -177,58 +227,41 @@ void GranularSynth::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuf
     mParameters.ui.trimPlaybackSample += numSample;
   }
 
-  // Add contributions from each note
-  auto bufferChannels = buffer.getArrayOfWritePointers();
-  for (int i = 0; i < bufferNumSample; ++i) {
-    // Don't use a for(auto x : mActiveNotes) loop here as mActiveNotes can be added outside this function. If it is partially added
-    // it might to use it and the undefined data will cause a crash eventually
-    const int activeNoteSize = mActiveNotes.size();
-    for (int noteIndex = 0; noteIndex < activeNoteSize; noteIndex++) {
-      // TODO: fix bug where gNote is null here in Debug
-      GrainNote& gNote = mActiveNotes.getReference(noteIndex);
-
-      // Add contributions from the grains in this generator
-      float genSample = 0.0f;
-      for (int genIdx = 0; genIdx < NUM_GENERATORS; ++genIdx) {
-        ParamGenerator* paramGenerator = mParameters.note.notes[gNote.pitchClass]->generators[genIdx].get();
-        const float attack = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::ATTACK);
-        const float decay = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::DECAY);
-        const float sustain = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::SUSTAIN);
-        const float release = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::RELEASE);
-        const float grainGain = gNote.genAmpEnvs[genIdx].getAmplitude(mTotalSamps, attack * mSampleRate, decay * mSampleRate, sustain,
-                                                                release * mSampleRate);
-        for (Grain& grain : gNote.genGrains[genIdx]) {
-          genSample += grain.process(mAudioBuffer, grainGain, mTotalSamps);
-        }
-
-        // Process filter and optionally use for output
-        const float filterOutput = paramGenerator->filter.processSample(0, genSample);
-
-        // If filter type isn't "none", use its output
-        const int filtType = mParameters.getChoiceParam(paramGenerator, ParamCommon::Type::FILT_TYPE);
-        if (filtType != Utils::FilterType::NO_FILTER) {
-          genSample = filterOutput;
-        }
-
-        // Add sample to all channels
-        // TODO: panning here
-        for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
-          bufferChannels[ch][i] += genSample;
-        }
-      }
+  // Notes start and stop at the sample of their event, so the block is rendered in pieces between the events. Grains are not
+  // split on, each one is delayed to its own sample inside the piece, so the output doesn't depend on the host's block size
+  juce::int64 spawnTicks = 0;
+  auto midiIt = midiMessages.cbegin();
+  for (int startSample = 0; startSample < bufferNumSample;) {
+    for (; midiIt != midiMessages.cend() && (*midiIt).samplePosition <= startSample; ++midiIt) {
+      handleMidiMessage((*midiIt).getMessage());
     }
-    mTotalSamps++;
+    // No larger than what the scratch buffers were prepared for
+    const int endSample = (midiIt != midiMessages.cend()) ? (*midiIt).samplePosition : bufferNumSample;
+    const int numSamples = getSamplesToNextEvent(juce::jmin(endSample - startSample, mMaxBlockSize));
+
+    juce::int64 ticks = juce::Time::getHighResolutionTicks();
+    spawnGrains(numSamples);
+    spawnTicks += juce::Time::getHighResolutionTicks() - ticks;
+    renderGrains(buffer, startSample, numSamples);
+
+    ticks = juce::Time::getHighResolutionTicks();
+    advanceGrains(numSamples);
+    spawnTicks += juce::Time::getHighResolutionTicks() - ticks;
+    startSample += numSamples;
+  }
+  // Events stamped past the end of the block are played from the next one
+  for (; midiIt != midiMessages.cend(); ++midiIt) {
+    handleMidiMessage((*midiIt).getMessage());
   }
+  mBlockStats.spawnMs = BlockStats::ticksToMs(spawnTicks);
 
   // Clip buffers to valid range
   for (int i = 0; i < buffer.getNumChannels(); i++) {
     juce::FloatVectorOperations::clip(buffer.getWritePointer(i), buffer.getReadPointer(i), -1.0f, 1.0f, bufferNumSample);
   }
 
-  handleGrainAddRemove(bufferNumSample);
-
   // Reset timestamps if no grains active to keep numbers low
-  if (mActiveNotes.isEmpty()) {
+  if (mNumActiveVoices == 0) {
     mTotalSamps = 0;
   } else {
     // Normalize the block before sending onward
@@ -240,6 +273,98 @@ void GranularSynth::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuf
       }
     } */
   }
+
+  mBlockStats.activeVoices = mNumActiveVoices;
+  for (const GrainNote& gNote : mVoices) {
+    if (!gNote.isActive) continue;
+    for (const GrainBank& grains : gNote.genGrains) {
+      mBlockStats.activeGrains += grains.size();
+    }
+  }
+  mBlockStats.blockMs = BlockStats::ticksToMs(juce::Time::getHighResolutionTicks() - blockStartTicks);
+  mBlockStatsFifo.push(mBlockStats);
+}
+
+void GranularSynth::renderGrains(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
+  float* genLeft = mGenBuffer.getWritePointer(GenBufferChannel::GRAINS_LEFT);
+  float* genRight = mGenBuffer.getWritePointer(GenBufferChannel::GRAINS_RIGHT);
+  float* envSamples = mGenBuffer.getWritePointer(GenBufferChannel::ENVELOPE);
+  const int blockStartTs = mTotalSamps;
+  juce::int64 mixTicks = 0;
+  juce::int64 filterTicks = 0;
+
+  for (GrainNote& gNote : mVoices) {
+    if (!gNote.isActive) continue;
+
+    for (int genIdx = 0; genIdx < NUM_GENERATORS; ++genIdx) {
+      const ParamSnapshot::Generator& genParams = mParameters.snapshot.generators[gNote.pitchClass][genIdx];
+      const float attack = genParams.common[ParamCommon::Type::ATTACK] * mSampleRate;
+      const float decay = genParams.common[ParamCommon::Type::DECAY] * mSampleRate;
+      const float sustain = genParams.common[ParamCommon::Type::SUSTAIN];
+      const float release = genParams.common[ParamCommon::Type::RELEASE] * mSampleRate;
+
+      // The envelope is stateful, so keep advancing it even when there are no grains to apply it to
+      juce::int64 ticks = juce::Time::getHighResolutionTicks();
+      Utils::EnvelopeADSR& ampEnv = gNote.genAmpEnvs[genIdx];
+      for (int i = 0; i < numSamples; ++i) {
+        envSamples[i] = ampEnv.getAmplitude(blockStartTs + i, attack, decay, sustain, release);
+      }
+
+      // A stolen voice ramps down to silence, advanceGrains() hands it to its new note once it is silent
+      if (gNote.isStolen()) {
+        for (int i = 0; i < numSamples; ++i) {
+          envSamples[i] *= juce::jmax(0, gNote.stealFadeLeft - i) / (float)gNote.stealFadeLength;
+        }
+      }
+
+      GrainBank& grains = gNote.genGrains[genIdx];
+      const int filtType = static_cast<int>(genParams.common[ParamCommon::Type::FILT_TYPE]);
+      const bool isFiltered = filtType != Utils::FilterType::NO_FILTER;
+      bool& isFilterRinging = mIsFilterRinging[gNote.pitchClass][genIdx];
+      if (grains.size() == 0 && !(isFiltered && isFilterRinging)) {
+        mixTicks += juce::Time::getHighResolutionTicks() - ticks;
+        continue;
+      }
+
+      // All grains are mixed for the whole block before the generator envelope is applied once
+      juce::FloatVectorOperations::clear(genLeft, numSamples);
+      juce::FloatVectorOperations::clear(genRight, numSamples);
+      if (grains.size() > 0) {
+        grains.process(mAudioBuffer, genLeft, genRight, numSamples, mParameters.snapshot.interpolation);
+        juce::FloatVectorOperations::multiply(genLeft, envSamples, numSamples);
+        juce::FloatVectorOperations::multiply(genRight, envSamples, numSamples);
+      }
+
+      // If filter type isn't "none", run the block through the generator's filter
+      if (isFiltered) {
+        const juce::int64 filterStartTicks = juce::Time::getHighResolutionTicks();
+        mixTicks += filterStartTicks - ticks;
+        float* genChannels[] = {genLeft, genRight};
+        juce::dsp::AudioBlock<float> genBlock(genChannels, 2, static_cast<size_t>(numSamples));
+        juce::dsp::StateVariableTPTFilter<float>& filter = mParameters.note.notes[gNote.pitchClass]->generators[genIdx]->filter;
+        filter.process(juce::dsp::ProcessContextReplacing<float>(genBlock));
+        // After the last grain the filter keeps running on silence until its ringing dies out
+        const juce::Range<float> outRange = genBlock.findMinAndMax();
+        isFilterRinging = grains.size() > 0 || juce::jmax(outRange.getEnd(), -outRange.getStart()) > FILTER_SILENCE_LEVEL;
+        ticks = juce::Time::getHighResolutionTicks();
+        filterTicks += ticks - filterStartTicks;
+      }
+
+      // Panning was already applied per grain, a mono bus gets the downmix
+      if (buffer.getNumChannels() == 1) {
+        float* out = buffer.getWritePointer(0, startSample);
+        juce::FloatVectorOperations::addWithMultiply(out, genLeft, 0.5f, numSamples);
+        juce::FloatVectorOperations::addWithMultiply(out, genRight, 0.5f, numSamples);
+      } else {
+        juce::FloatVectorOperations::add(buffer.getWritePointer(0, startSample), genLeft, numSamples);
+        juce::FloatVectorOperations::add(buffer.getWritePointer(1, startSample), genRight, numSamples);
+      }
+      mixTicks += juce::Time::getHighResolutionTicks() - ticks;
+    }
+  }
+  mTotalSamps += numSamples;
+  mBlockStats.mixMs += BlockStats::ticksToMs(mixTicks);
+  mBlockStats.filterMs += BlockStats::ticksToMs(filterTicks);
 }
 
 //==============================================================================
@@ -275,20 +400,23 @@ void GranularSynth::setStateInformation(const void* data, int sizeInBytes) {
   auto xml = getXmlFromBinary(data, sizeInBytes);
 
   if (xml != nullptr) {
-    auto params = xml->getChildByName("AudioParams");
-    if (params != nullptr) {
-      for (auto& param : getParameters()) {
-        param->setValueNotifyingHost(params->getDoubleAttribute(ParamHelper::getParamID(param), param->getValue()));
-      }
-    }
+    setAudioParamsXml(xml->getChildByName("AudioParams"));
 
-    params = xml->getChildByName("ParamUI");
+    auto params = xml->getChildByName("ParamUI");
     if (params != nullptr) {
       mParameters.ui.setXml(params);
     }
   }
 }
 
+void GranularSynth::setAudioParamsXml(juce::XmlElement* params) {
+  if (params != nullptr) {
+    for (auto& param : getParameters()) {
+      param->setValueNotifyingHost(params->getDoubleAttribute(ParamHelper::getParamID(param), param->getValue()));
+    }
+  }
+}
+
 // These are slightly different then the get/setStateInformation. These are for
 // 'user params' which include items that are related to audio, but not actually
 // juce::AudioParam items that the DAW can use
@@ -310,14 +438,9 @@ void GranularSynth::setPresetParamsXml(const void* data, int sizeInBytes) {
   auto xml = getXmlFromBinary(data, sizeInBytes);
 
   if (xml != nullptr) {
-    auto params = xml->getChildByName("AudioParams");
-    if (params != nullptr) {
-      for (auto& param : getParameters()) {
-        param->setValueNotifyingHost(params->getDoubleAttribute(ParamHelper::getParamID(param), param->getValue()));
-      }
-    }
+    setAudioParamsXml(xml->getChildByName("AudioParams"));
 
-    params = xml->getChildByName("NotesParams");
+    auto params = xml->getChildByName("NotesParams");
     if (params != nullptr) {
       mParameters.note.setXml(params);
     }
@@ -326,9 +449,77 @@ void GranularSynth::setPresetParamsXml(const void* data, int sizeInBytes) {
     if (params != nullptr) {
       mParameters.ui.setXml(params);
     }
+    publishCandidates();
   }
 }
 
+void GranularSynth::loadPreset(juce::File file, juce::String& errorMessage, bool audioParamsOnly) {
+  Preset::Header header;
+  juce::FileInputStream input(file);
+  if (!input.openedOk()) {
+    errorMessage = juce::String::formatted("The file failed to open because %s", input.getStatus().getErrorMessage().toRawUTF8());
+    return;
+  }
+  input.read(&header, sizeof(header));
+
+  if (header.magic != Preset::MAGIC) {
+    errorMessage = "The file is not recognized as a valid .gbow preset file.";
+    return;
+  }
+
+  // Currently there is only a VERSION_MAJOR of 0
+  if (header.versionMajor != 0) {
+    errorMessage = juce::String::formatted(
+        "The file is gbow version %u.%u and is not supported. This copy of gRainbow can open files up to version %u.%u",
+        header.versionMajor, header.versionMinor, Preset::VERSION_MAJOR, Preset::VERSION_MINOR);
+    return;
+  }
+
+  // Get Audio Buffer blob
+  juce::AudioBuffer<float> fileAudioBuffer;
+  if (audioParamsOnly) {
+    input.skipNextBytes(header.audioBufferSize);
+  } else {
+    fileAudioBuffer.setSize(header.audioBufferChannel, header.audioBufferNumberOfSamples);
+    input.read(fileAudioBuffer.getWritePointer(0), header.audioBufferSize);
+  }
+
+  // Get offsets and load all png for spec images
+  if (audioParamsOnly) {
+    input.skipNextBytes(header.specImageSpectrogramSize + header.specImageHpcpSize + header.specImageDetectedSize);
+  } else {
+    uint32_t maxSpecImageSize = juce::jmax(header.specImageSpectrogramSize, header.specImageHpcpSize, header.specImageDetectedSize);
+    void* specImageData = malloc(maxSpecImageSize);
+    jassert(specImageData != nullptr);
+    input.read(specImageData, header.specImageSpectrogramSize);
+    mParameters.ui.specImages[ParamUI::SpecType::SPECTROGRAM] =
+        juce::PNGImageFormat::loadFrom(specImageData, header.specImageSpectrogramSize);
+    input.read(specImageData, header.specImageHpcpSize);
+    mParameters.ui.specImages[ParamUI::SpecType::HPCP] = juce::PNGImageFormat::loadFrom(specImageData, header.specImageHpcpSize);
+    input.read(specImageData, header.specImageDetectedSize);
+    mParameters.ui.specImages[ParamUI::SpecType::DETECTED] =
+        juce::PNGImageFormat::loadFrom(specImageData, header.specImageDetectedSize);
+    free(specImageData);
+  }
+
+  // juce::FileInputStream uses 'int' to read
+  int xmlSize = static_cast<int>(input.getTotalLength() - input.getPosition());
+  juce::MemoryBlock xmlData;
+  input.readIntoMemoryBlock(xmlData, xmlSize);
+
+  if (audioParamsOnly) {
+    auto xml = getXmlFromBinary(xmlData.getData(), static_cast<int>(xmlData.getSize()));
+    if (xml != nullptr) {
+      setAudioParamsXml(xml->getChildByName("AudioParams"));
+    }
+    return;
+  }
+
+  setPresetParamsXml(xmlData.getData(), static_cast<int>(xmlData.getSize()));
+  setInputBuffer(&fileAudioBuffer, header.audioBufferSamplerRate);
+  processInput(juce::Range<juce::int64>(), true);
+}
+
 //==============================================================================
 // This creates new instances of the plugin.
 // For all intents and purposes "main()" for standalone and/or any plugin
@@ -349,97 +540,150 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter() {
   return synth;
 }
 
-void GranularSynth::handleGrainAddRemove(int blockSize) {
-  if (mLoadingProgress == 1.0) {
-    // Add one grain per active note
-    for (GrainNote& gNote : mActiveNotes) {
-      for (int i = 0; i < gNote.grainTriggers.size(); ++i) {
-        if (gNote.grainTriggers[i] <= 0) {
-          ParamGenerator* paramGenerator = mParameters.note.notes[gNote.pitchClass]->generators[i].get();
-          ParamCandidate* paramCandidate = mParameters.note.notes[gNote.pitchClass]->getCandidate(i);
-          float durSec;
-          const float gain = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::GAIN);
-          const float grainRate = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::GRAIN_RATE);
-          const float grainDuration = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::GRAIN_DURATION);
-          const bool grainSync = mParameters.getBoolParam(paramGenerator, ParamCommon::Type::GRAIN_SYNC);
-          const float pitchAdjust = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::PITCH_ADJUST);
-          const float pitchSpray = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::PITCH_SPRAY);
-          const float posAdjust = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::POS_ADJUST);
-          const float posSpray = mParameters.getFloatParam(paramGenerator, ParamCommon::Type::POS_SPRAY);
-
-          if (grainSync) {
-            float div = std::pow(2, (int)(ParamRanges::SYNC_DIV_MAX * ParamRanges::GRAIN_DURATION.convertTo0to1(grainDuration)));
-            double bpm = DEFAULT_BPM;
-            int beatsPerBar = 4;
-            if (juce::AudioPlayHead* playhead = getPlayHead()) {
-              juce::Optional<juce::AudioPlayHead::PositionInfo> info = playhead->getPosition();
-              juce::Optional<double> newBpm = info->getBpm();
-              if (newBpm) {
-                bpm = *newBpm;
-              }
-              juce::Optional<juce::AudioPlayHead::TimeSignature> newTimeSignature = info->getTimeSignature();
-              if (newTimeSignature) {
-                beatsPerBar = (*newTimeSignature).numerator;
-              }
+void GranularSynth::spawnGrains(int numSamples) {
+  // Candidates show up while the analysis is still running, until then each generator takes its own like
+  // setStartingCandidatePosition() will do once it is done
+  const bool isLoading = mLoadingProgress < 1.0;
+  const double endTs = static_cast<double>(mTotalSamps + numSamples);
+  // Add the grains due before endTs for each active note, a stolen voice only lets its grains fade out
+  for (GrainNote& gNote : mVoices) {
+    if (!gNote.isActive || gNote.isStolen()) continue;
+    for (int i = 0; i < gNote.grainTriggers.size(); ++i) {
+      while (std::ceil(gNote.grainTriggers[i]) < endTs) {
+        // The grain starts on the first sample at or after its trigger, wherever the block boundaries are
+        const int startDelay = juce::jmax(0, static_cast<int>(std::ceil(gNote.grainTriggers[i]) - mTotalSamps));
+        ParamNote* paramNote = mParameters.note.notes[gNote.pitchClass].get();
+        ParamGenerator* paramGenerator = paramNote->generators[i].get();
+        const ParamSnapshot::Generator& genParams = mParameters.snapshot.generators[gNote.pitchClass][i];
+        const int candidateIdx =
+            isLoading ? juce::jmin(i, mCandidateTable.getNumCandidates(gNote.pitchClass) - 1) : genParams.candidateIdx;
+        ParamCandidate candidate(0.0f, 1.0f, 0.0f, 0.0f);
+        ParamCandidate* paramCandidate = mCandidateTable.get(gNote.pitchClass, candidateIdx, candidate) ? &candidate : nullptr;
+        float durSec;
+        const float gain = genParams.common[ParamCommon::Type::GAIN];
+        const float grainRate = genParams.common[ParamCommon::Type::GRAIN_RATE];
+        const float grainDuration = genParams.common[ParamCommon::Type::GRAIN_DURATION];
+        const bool grainSync = genParams.common[ParamCommon::Type::GRAIN_SYNC] != 0.0f;
+        const float pitchAdjust = genParams.common[ParamCommon::Type::PITCH_ADJUST];
+        const float pitchSpray = genParams.common[ParamCommon::Type::PITCH_SPRAY];
+        const float posAdjust = genParams.common[ParamCommon::Type::POS_ADJUST];
+        const float posSpray = genParams.common[ParamCommon::Type::POS_SPRAY];
+        const float panAdjust = genParams.common[ParamCommon::Type::PAN_ADJUST];
+        const float panSpray = genParams.common[ParamCommon::Type::PAN_SPRAY];
+
+        if (grainSync) {
+          float div = std::pow(2, (int)(ParamRanges::SYNC_DIV_MAX * ParamRanges::GRAIN_DURATION.convertTo0to1(grainDuration)));
+          double bpm = DEFAULT_BPM;
+          int beatsPerBar = 4;
+          if (juce::AudioPlayHead* playhead = getPlayHead()) {
+            juce::Optional<juce::AudioPlayHead::PositionInfo> info = playhead->getPosition();
+            juce::Optional<double> newBpm = info->getBpm();
+            if (newBpm) {
+              bpm = *newBpm;
+            }
+            juce::Optional<juce::AudioPlayHead::TimeSignature> newTimeSignature = info->getTimeSignature();
+            if (newTimeSignature) {
+              beatsPerBar = (*newTimeSignature).numerator;
             }
-            // Find synced duration using bpm
-            durSec = (1.0f / bpm) * 60.0f * (beatsPerBar / div);
-          } else {
-            durSec = grainDuration;
-          }
-          // Skip adding new grain if not enabled or full of grains
-          if (paramCandidate != nullptr && mParameters.note.notes[gNote.pitchClass]->shouldPlayGenerator(i) &&
-              gNote.genGrains.size() < MAX_GRAINS) {
-            float durSamples = mSampleRate * durSec * (1.0f / paramCandidate->pbRate);
-            /* Position calculation */
-            juce::Random random;
-            float posSprayOffset =
-                juce::jmap(random.nextFloat(), ParamRanges::POSITION_SPRAY.start, posSpray) *
-                mSampleRate;
-            if (random.nextFloat() > 0.5f) posSprayOffset = -posSprayOffset;
-            float posOffset = posAdjust * durSamples + posSprayOffset;
-            float posSamples = paramCandidate->posRatio * mAudioBuffer.getNumSamples() + posOffset;
-
-            /* Pitch calculation */
-            float pitchSprayOffset = juce::jmap(random.nextFloat(), 0.0f, pitchSpray);
-            if (random.nextFloat() > 0.5f) pitchSprayOffset = -pitchSprayOffset;
-            float pbRate = paramCandidate->pbRate + pitchAdjust + pitchSprayOffset;
-            jassert(paramCandidate->pbRate > 0.1f);
-
-            /* Add grain */
-            auto grain =
-                Grain(paramGenerator->grainEnvLUT, durSamples, pbRate, posSamples, mTotalSamps, gain);
-            gNote.genGrains[i].add(grain);
-
-            /* Trigger grain in arcspec */
-            float totalGain = gain * gNote.genAmpEnvs[i].amplitude * gNote.velocity;
-            mParameters.note.grainCreated(gNote.pitchClass, i, durSec / pbRate, totalGain);
-          }
-          // Reset trigger ts
-          if (grainSync) {
-            float div = std::pow(2, (int)(ParamRanges::SYNC_DIV_MAX * ParamRanges::GRAIN_RATE.convertTo0to1(grainRate)));
-            // Find synced rate interval using bpm
-            float intervalSamples = mSampleRate * durSec / div;
-            gNote.grainTriggers[i] += intervalSamples;
-          } else {
-            gNote.grainTriggers[i] += mSampleRate * juce::jmap(ParamRanges::GRAIN_RATE.convertTo0to1(grainRate),
-                                         durSec * MIN_RATE_RATIO, durSec * MAX_RATE_RATIO);
           }
+          // Find synced duration using bpm
+          durSec = (1.0f / bpm) * 60.0f * (beatsPerBar / div);
+        } else {
+          durSec = grainDuration;
+        }
+        // Skip adding new grain if not enabled or full of grains
+        const bool canPlay = paramCandidate != nullptr && genParams.shouldPlay;
+        if (canPlay && gNote.genGrains[i].isFull()) {
+          mBlockStats.grainsDropped++;
+        } else if (canPlay) {
+          float durSamples = mSampleRate * durSec * (1.0f / paramCandidate->pbRate);
+          /* Position calculation */
+          juce::Random random;
+          float posSprayOffset =
+              juce::jmap(random.nextFloat(), ParamRanges::POSITION_SPRAY.start, posSpray) *
+              mSampleRate;
+          if (random.nextFloat() > 0.5f) posSprayOffset = -posSprayOffset;
+          float posOffset = posAdjust * durSamples + posSprayOffset;
+          float posSamples = paramCandidate->posRatio * mAudioBuffer.getNumSamples() + posOffset;
+
+          /* Pitch calculation */
+          float pitchSprayOffset = juce::jmap(random.nextFloat(), 0.0f, pitchSpray);
+          if (random.nextFloat() > 0.5f) pitchSprayOffset = -pitchSprayOffset;
+          float pbRate = paramCandidate->pbRate + pitchAdjust + pitchSprayOffset;
+          jassert(paramCandidate->pbRate > 0.1f);
+
+          /* Pan calculation */
+          float panSprayOffset = juce::jmap(random.nextFloat(), 0.0f, panSpray);
+          if (random.nextFloat() > 0.5f) panSprayOffset = -panSprayOffset;
+          float pan = juce::jlimit(-1.0f, 1.0f, panAdjust + panSprayOffset);
+
+          /* Add grain */
+          gNote.genGrains[i].add(paramGenerator->grainEnv.load(), ENV_LUT_SIZE, durSamples, pbRate, posSamples,
+                                 mAudioBuffer.getNumSamples(), pan, startDelay);
+          mBlockStats.grainsSpawned++;
+
+          /* Trigger grain in arcspec */
+          float totalGain = gain * gNote.genAmpEnvs[i].amplitude * gNote.velocity;
+          mGrainEventFifo.push(GrainEvent{gNote.pitchClass, i, durSec / pbRate, totalGain, paramCandidate->posRatio,
+                                          paramCandidate->duration, paramCandidate->pbRate, posAdjust, pitchAdjust});
+        }
+        // Reset trigger ts, at least a sample later so the loop always moves on
+        double intervalSamples;
+        if (grainSync) {
+          float div = std::pow(2, (int)(ParamRanges::SYNC_DIV_MAX * ParamRanges::GRAIN_RATE.convertTo0to1(grainRate)));
+          // Find synced rate interval using bpm
+          intervalSamples = mSampleRate * durSec / div;
         } else {
-          gNote.grainTriggers[i] -= blockSize;
+          intervalSamples = mSampleRate * juce::jmap(ParamRanges::GRAIN_RATE.convertTo0to1(grainRate), durSec * MIN_RATE_RATIO,
+                                                     durSec * MAX_RATE_RATIO);
         }
+        gNote.grainTriggers[i] += juce::jmax(1.0, intervalSamples);
       }
     }
   }
-  // Delete expired grains
-  for (GrainNote& gNote : mActiveNotes) {
-    for (int genIdx = 0; genIdx < NUM_GENERATORS; ++genIdx) {
-      gNote.genGrains[genIdx].removeIf([this](Grain& g) { return mTotalSamps > (g.trigTs + g.duration); });
+}
+
+int GranularSynth::getSamplesToNextEvent(int maxSamples) const {
+  int numSamples = maxSamples;
+  for (const GrainNote& gNote : mVoices) {
+    if (!gNote.isActive) continue;
+    if (gNote.isStolen()) {
+      numSamples = juce::jmin(numSamples, gNote.stealFadeLeft);
+      continue;
     }
+    if (gNote.removeTs != -1) numSamples = juce::jmin(numSamples, static_cast<int>(gNote.removeTs - mTotalSamps));
   }
+  return juce::jmax(1, numSamples);
+}
+
+void GranularSynth::advanceGrains(int numSamples) {
+  for (GrainNote& gNote : mVoices) {
+    if (!gNote.isActive) continue;
+    if (gNote.isStolen()) {
+      // Silent now, the voice is handed to the note waiting on it
+      gNote.stealFadeLeft -= numSamples;
+      if (gNote.stealFadeLeft <= 0) {
+        gNote.stealFadeLeft = 0;
+        if (gNote.pendingPitchClass != Utils::PitchClass::NONE) {
+          gNote.start(gNote.pendingPitchClass, gNote.pendingVelocity, mTotalSamps, gNote.age);
+        } else {
+          gNote.isActive = false;
+          mNumActiveVoices--;
+          continue;
+        }
+      }
+    }
+    // Delete expired grains
+    for (GrainBank& grains : gNote.genGrains) {
+      grains.removeFinished();
+    }
 
-  // Delete expired notes
-  mActiveNotes.removeIf([this](GrainNote& gNote) { return gNote.removeTs != -1 && mTotalSamps >= gNote.removeTs; });
+    // Free the voice once its release is done
+    if (gNote.removeTs != -1 && mTotalSamps >= gNote.removeTs) {
+      gNote.isActive = false;
+      mNumActiveVoices--;
+    }
+  }
 }
 
 void GranularSynth::setInputBuffer(juce::AudioBuffer<float>* audioBuffer, double sampleRate) {
@@ -463,14 +707,21 @@ void GranularSynth::setInputBuffer(juce::AudioBuffer<float>* audioBuffer, double
 }
 
 void GranularSynth::processInput(juce::Range<juce::int64> range, bool preset) {
-  // Cancel processing if in progress
-  mFft.stopThread(4000);
+  // Cancel processing if in progress, a cache lookup still running would publish the old input
+  mAnalysisLoaded.wait();
   mPitchDetector.cancelProcessing();
 
   // TODO - we clear mInputBuffer here, but processBlock still in theory might need it one last time. Find a proper system for
   // knowing when the buffer is not needed (Or find a way to have a single buffer as stated in the TODO where it is cleared)
   mParameters.ui.trimPlaybackOn = false;
 
+  const bool isTrimFromFull = !range.isEmpty() && mIsTrimFromFullAnalysis && !preset;
+  // Candidates of the old input are meaningless for the new audio buffer
+  if (!preset) {
+    mLoadingProgress = 0.0;
+    mCandidateTable.clear();
+  }
+
   // If a range to trim is provided then
   if (range.isEmpty()) {
     mAudioBuffer.setSize(mInputBuffer.getNumChannels(), mInputBuffer.getNumSamples());
@@ -487,21 +738,84 @@ void GranularSynth::processInput(juce::Range<juce::int64> range, bool preset) {
   // clear() keeps memory around
   // TODO - Find a way to trim the mInputBuffer without having to make another copy. Or find a way so only 1 of these needs to live
   // on the heap and the other can be remove after used on the stack
+  if (isTrimFromFull) {
+    mAnalysisBuffer = std::move(mInputBuffer);
+  }
   mInputBuffer.setSize(1, 1);
 
   // preset don't need to generate things again
   if (!preset) {
     // Only place that should reset params on loading files/presets
     resetParameters();
-    mLoadingProgress = 0.0;
     mProcessedSpecs.fill(nullptr);
-    mFft.process(&mAudioBuffer);
-    mPitchDetector.process(&mAudioBuffer, mSampleRate);
+
+    mAnalysisHpcp = nullptr;
+    mTrimFrames = juce::Range<int>();
+    mTrimPosOffset = 0.0f;
+    // Hashing the audio and decompressing a cached analysis take a while for long inputs, keep them off the message thread
+    mAnalysisLoaded.reset();
+    mThreadPool->addJob([this, range, isTrimFromFull, sampleRate = mSampleRate, analysisParams = getAnalysisParams()] {
+      loadAnalysis(range, isTrimFromFull, sampleRate, analysisParams);
+      mAnalysisLoaded.signal();
+    });
   } else {
     mLoadingProgress = 1.0;
   }
 }
 
+void GranularSynth::loadAnalysis(juce::Range<juce::int64> range, bool isTrimFromFull, double sampleRate,
+                                 const juce::String& analysisParams) {
+  PitchDetector::PitchMap pitchMap;
+  if (isTrimFromFull) {
+    // Only the spectrogram and HPCP of the whole input are reused, the pitches are per selection. Without a cached analysis of
+    // the whole input it is quicker to analyze just the selection
+    const juce::String fullKey = AnalysisCache::getKey(mAnalysisBuffer, sampleRate, analysisParams);
+    mAnalysisBuffer = juce::AudioBuffer<float>();
+    Utils::SpecBuffer fullHpcp;
+    if (mAnalysisCache.load(fullKey, mFullSpectrogram, fullHpcp, pitchMap)) {
+      // Frames whose hop starts inside the selection, the same frames analyzing only the selection would have
+      const int startFrame = static_cast<int>(range.getStart() / PitchDetector::HOP_SIZE);
+      mTrimFrames = juce::Range<int>::withStartAndLength(startFrame, mAudioBuffer.getNumSamples() / PitchDetector::HOP_SIZE + 1);
+      // The first frame starts up to a hop before the selection does, positions are shifted back by that part of a frame
+      const float startOffsetFrames = (range.getStart() % PitchDetector::HOP_SIZE) / (float)PitchDetector::HOP_SIZE;
+      mTrimPosOffset = startOffsetFrames / mTrimFrames.getLength();
+      mShouldStoreAnalysis = false;
+      setTrimmedSpectrogram();
+      mProcessedSpecs[ParamUI::SpecType::SPECTROGRAM] = &mSpectrogram;
+      mPitchDetector.processHPCP(std::move(fullHpcp), sampleRate, mTrimFrames);
+      return;
+    }
+    pitchMap.clear();
+  }
+  mAnalysisKey = AnalysisCache::getKey(mAudioBuffer, sampleRate, analysisParams);
+  mShouldStoreAnalysis = !mAnalysisCache.load(mAnalysisKey, mSpectrogram, mHpcpCopy, pitchMap);
+  if (mShouldStoreAnalysis) {
+    mPitchDetector.process(&mAudioBuffer, sampleRate);
+  } else {
+    // Published the same way onPitchesReady does when the detector finishes
+    PitchDetector::makePitchBuffer(pitchMap, mHpcpCopy.size(), mPitchSpecCopy);
+    mProcessedSpecs[ParamUI::SpecType::SPECTROGRAM] = &mSpectrogram;
+    mProcessedSpecs[ParamUI::SpecType::HPCP] = &mHpcpCopy;
+    mProcessedSpecs[ParamUI::SpecType::DETECTED] = &mPitchSpecCopy;
+    createCandidates(pitchMap);
+    mLoadingProgress = 1.0;
+  }
+}
+
+void GranularSynth::setTrimmedSpectrogram() {
+  const size_t startFrame = mTrimFrames.getStart() / SPECTROGRAM_FRAME_STEP;
+  const size_t endFrame = (mTrimFrames.getEnd() + SPECTROGRAM_FRAME_STEP - 1) / SPECTROGRAM_FRAME_STEP;
+  mSpectrogram.setSlice(mFullSpectrogram, startFrame, endFrame - startFrame);
+  // Same scale as if only the selection was analyzed
+  normalizeSpec(mSpectrogram);
+}
+
+juce::String GranularSynth::getAnalysisParams() const {
+  return juce::String::formatted("fft %d hop %d spectrogram step %d whiten %d segments %d", PitchDetector::FFT_SIZE,
+                                 PitchDetector::HOP_SIZE, SPECTROGRAM_FRAME_STEP, (int)getSpectralWhitening(),
+                                 getNumPitchSegments());
+}
+
 std::vector<ParamCandidate*> GranularSynth::getActiveCandidates() {
   std::vector<ParamCandidate*> candidates;
   for (int i = 0; i < NUM_GENERATORS; ++i) {
@@ -514,31 +828,105 @@ std::vector<ParamCandidate*> GranularSynth::getActiveCandidates() {
   return candidates;
 }
 
+juce::Array<Utils::MidiNote> GranularSynth::getMidiNotes() const {
+  juce::Array<Utils::MidiNote> midiNotes;
+  const Utils::PitchClass lastPitchClass = mLastPitchClass;
+  for (Utils::PitchClass pitchClass : Utils::ALL_PITCH_CLASS) {
+    if (pitchClass != lastPitchClass && mIsNoteHeld[pitchClass]) {
+      midiNotes.add(Utils::MidiNote(pitchClass, mNoteVelocities[pitchClass]));
+    }
+  }
+  if (mIsNoteHeld[lastPitchClass]) midiNotes.add(Utils::MidiNote(lastPitchClass, mNoteVelocities[lastPitchClass]));
+  return midiNotes;
+}
+
+// Only the on-screen keyboard calls the keyboard state, so these are on the message thread
 void GranularSynth::handleNoteOn(juce::MidiKeyboardState* state, int midiChannel, int midiNoteNumber, float velocity) {
-  mLastPitchClass = Utils::getPitchClass(midiNoteNumber);
-  mMidiNotes.add(Utils::MidiNote(mLastPitchClass, velocity));
-  mActiveNotes.add(GrainNote(mLastPitchClass, velocity, Utils::EnvelopeADSR(mTotalSamps)));
+  pushKeyboardNote(midiNoteNumber, velocity, true);
 }
 
 void GranularSynth::handleNoteOff(juce::MidiKeyboardState* state, int midiChannel, int midiNoteNumber, float velocity) {
-  const Utils::PitchClass pitchClass = Utils::getPitchClass(midiNoteNumber);
+  pushKeyboardNote(midiNoteNumber, velocity, false);
+}
+
+void GranularSynth::pushKeyboardNote(int midiNoteNumber, float velocity, bool isNoteOn) {
+  const auto scope = mKeyboardFifo.write(1);
+  if (scope.blockSize1 > 0) {
+    mKeyboardNotes[scope.startIndex1] = KeyboardNote{Utils::getPitchClass(midiNoteNumber), velocity, isNoteOn};
+  }
+}
 
-  for (Utils::MidiNote* it = mMidiNotes.begin(); it != mMidiNotes.end(); it++) {
-    if (it->pitch == pitchClass) {
-      mMidiNotes.remove(it);
-      break;  // will only be at most 1 note (TODO assuming mouse and midi aren't set at same tim)
+void GranularSynth::handleKeyboardNotes() {
+  auto handleNote = [this](const KeyboardNote& note) {
+    if (note.isNoteOn) {
+      noteOn(note.pitchClass, note.velocity);
+    } else {
+      noteOff(note.pitchClass);
     }
+  };
+  const auto scope = mKeyboardFifo.read(mKeyboardFifo.getNumReady());
+  for (int i = 0; i < scope.blockSize1; ++i) handleNote(mKeyboardNotes[scope.startIndex1 + i]);
+  for (int i = 0; i < scope.blockSize2; ++i) handleNote(mKeyboardNotes[scope.startIndex2 + i]);
+}
+
+void GranularSynth::handleMidiMessage(const juce::MidiMessage& message) {
+  if (message.isNoteOn()) {
+    noteOn(Utils::getPitchClass(message.getNoteNumber()), message.getFloatVelocity());
+  } else if (message.isNoteOff()) {
+    noteOff(Utils::getPitchClass(message.getNoteNumber()));
   }
+}
 
-  for (GrainNote& gNote : mActiveNotes) {
-    if (gNote.pitchClass == pitchClass && gNote.removeTs == -1) {
+void GranularSynth::noteOn(Utils::PitchClass pitchClass, float velocity) {
+  startVoice(pitchClass, velocity);
+  mNumNotesHeld[pitchClass]++;
+  mNoteVelocities[pitchClass] = velocity;
+  mIsNoteHeld[pitchClass] = true;
+  mLastPitchClass = pitchClass;
+}
+
+void GranularSynth::noteOff(Utils::PitchClass pitchClass) {
+  stopVoice(pitchClass);
+  // A note off without its note on (held from before the plugin started) is ignored
+  if (mNumNotesHeld[pitchClass] > 0 && --mNumNotesHeld[pitchClass] == 0) mIsNoteHeld[pitchClass] = false;
+}
+
+void GranularSynth::startVoice(Utils::PitchClass pitchClass, float velocity) {
+  GrainNote* voice = nullptr;
+  if (mNumActiveVoices < mParameters.snapshot.polyphony) {
+    for (GrainNote& gNote : mVoices) {
+      if (!gNote.isActive) {
+        voice = &gNote;
+        mNumActiveVoices++;
+        break;
+      }
+    }
+  }
+  // Either the polyphony limit was hit or it was lowered while notes were still held
+  if (voice == nullptr) {
+    findVoiceToSteal().steal(pitchClass, velocity, mNextVoiceAge++, juce::jmax(1, (int)(STEAL_FADE_SEC * mSampleRate)));
+    return;
+  }
+  voice->start(pitchClass, velocity, mTotalSamps, mNextVoiceAge++);
+}
+
+void GranularSynth::stopVoice(Utils::PitchClass pitchClass) {
+  for (GrainNote& gNote : mVoices) {
+    // Released before the stolen voice it is waiting on went quiet, it is never started
+    if (gNote.isStolen()) {
+      if (gNote.pendingPitchClass == pitchClass) {
+        gNote.pendingPitchClass = Utils::PitchClass::NONE;
+        break;
+      }
+      continue;
+    }
+    if (gNote.isActive && gNote.pitchClass == pitchClass && gNote.removeTs == -1) {
       // Set timestamp to delete note based on release time and set note off for all generators
       float maxRelease = 0;
       for (int i = 0; i < NUM_GENERATORS; ++i) {
         gNote.genAmpEnvs[i].noteOff(mTotalSamps);
         // Update max release time
-        float release =
-            mParameters.getFloatParam(mParameters.note.notes[gNote.pitchClass]->generators[i].get(), ParamCommon::Type::RELEASE);
+        float release = mParameters.snapshot.generators[gNote.pitchClass][i].common[ParamCommon::Type::RELEASE];
         if (release >= maxRelease) maxRelease = release;
       }
       gNote.removeTs = mTotalSamps + (maxRelease * mSampleRate);
@@ -548,52 +936,91 @@ void GranularSynth::handleNoteOff(juce::MidiKeyboardState* state, int midiChanne
   }
 }
 
+GranularSynth::GrainNote& GranularSynth::findVoiceToSteal() {
+  // Voices already releasing are always taken before held ones
+  GrainNote* steal = nullptr;
+  for (GrainNote& gNote : mVoices) {
+    if (!gNote.isActive) continue;
+    if (steal == nullptr) {
+      steal = &gNote;
+      continue;
+    }
+    const bool isReleased = gNote.removeTs != -1;
+    const bool stealIsReleased = steal->removeTs != -1;
+    if (isReleased != stealIsReleased) {
+      if (isReleased) steal = &gNote;
+      continue;
+    }
+    if (mParameters.snapshot.voiceSteal == ParamGlobal::VoiceSteal::QUIETEST) {
+      if (gNote.getLevel() < steal->getLevel()) steal = &gNote;
+    } else if (gNote.age < steal->age) {
+      steal = &gNote;
+    }
+  }
+  jassert(steal != nullptr);
+  return *steal;
+}
+
 void GranularSynth::resetParameters(bool fullClear) {
   mParameters.note.resetParams(fullClear);
   mParameters.global.resetParams();
+  if (fullClear) publishCandidates();
+}
+
+void GranularSynth::publishCandidates() {
+  for (auto&& note : mParameters.note.notes) {
+    mCandidateTable.set((Utils::PitchClass)note->noteIdx, note->candidates);
+  }
 }
 
 void GranularSynth::createCandidates(juce::HashMap<Utils::PitchClass, std::vector<PitchDetector::Pitch>>& detectedPitches) {
   // Add candidates for each pitch class
   for (auto&& note : mParameters.note.notes) {
-    // Look for detected pitches with correct pitch and good gain
-    bool foundAll = false;
-    int numFound = 0;
-    int numSearches = 0;
-
-    while (!foundAll) {
-      int noteMin = note->noteIdx - numSearches;
-      int noteMax = note->noteIdx + numSearches;
-      // Check low note
-      std::vector<PitchDetector::Pitch>& pitchVec = detectedPitches.getReference((Utils::PitchClass)(noteMin % 12));
-      float pbRate = std::pow(Utils::TIMESTRETCH_RATIO, numSearches);
+    findCandidates(detectedPitches, note->noteIdx, note->candidates);
+    note->setStartingCandidatePosition();
+  }
+  publishCandidates();
+}
+
+void GranularSynth::findCandidates(PitchDetector::PitchMap& detectedPitches, int noteIdx,
+                                   std::vector<ParamCandidate>& candidates) const {
+  // Look for detected pitches with correct pitch and good gain
+  bool foundAll = false;
+  int numFound = 0;
+  int numSearches = 0;
+
+  while (!foundAll) {
+    int noteMin = noteIdx - numSearches;
+    int noteMax = noteIdx + numSearches;
+    // Check low note
+    std::vector<PitchDetector::Pitch>& pitchVec = detectedPitches.getReference((Utils::PitchClass)(noteMin % 12));
+    float pbRate = std::pow(Utils::TIMESTRETCH_RATIO, numSearches);
+    for (int i = 0; i < pitchVec.size(); ++i) {
+      if (pitchVec[i].gain < MIN_CANDIDATE_SALIENCE) continue;
+      const float posRatio = juce::jmax(0.0f, pitchVec[i].posRatio - mTrimPosOffset);
+      candidates.push_back(ParamCandidate(posRatio, pbRate, pitchVec[i].duration, pitchVec[i].gain));
+      numFound++;
+      if (numFound >= MAX_CANDIDATES) {
+        foundAll = true;
+        break;
+      }
+    }
+    // Check high note if we haven't filled up the list yet
+    if (!foundAll && numSearches > 0) {
+      std::vector<PitchDetector::Pitch>& pitchVec = detectedPitches.getReference((Utils::PitchClass)(noteMax % 12));
+      float pbRate = std::pow(Utils::TIMESTRETCH_RATIO, -numSearches);
       for (int i = 0; i < pitchVec.size(); ++i) {
         if (pitchVec[i].gain < MIN_CANDIDATE_SALIENCE) continue;
-        note->candidates.push_back(ParamCandidate(pitchVec[i].posRatio, pbRate, pitchVec[i].duration, pitchVec[i].gain));
+        const float posRatio = juce::jmax(0.0f, pitchVec[i].posRatio - mTrimPosOffset);
+        candidates.push_back(ParamCandidate(posRatio, pbRate, pitchVec[i].duration, pitchVec[i].gain));
         numFound++;
         if (numFound >= MAX_CANDIDATES) {
           foundAll = true;
           break;
         }
       }
-      // Check high note if we haven't filled up the list yet
-      if (!foundAll && numSearches > 0) {
-        std::vector<PitchDetector::Pitch>& pitchVec = detectedPitches.getReference((Utils::PitchClass)(noteMax % 12));
-        float pbRate = std::pow(Utils::TIMESTRETCH_RATIO, -numSearches);
-        for (int i = 0; i < pitchVec.size(); ++i) {
-          if (pitchVec[i].gain < MIN_CANDIDATE_SALIENCE) continue;
-          note->candidates.push_back(ParamCandidate(pitchVec[i].posRatio, pbRate, pitchVec[i].duration, pitchVec[i].gain));
-          numFound++;
-          if (numFound >= MAX_CANDIDATES) {
-            foundAll = true;
-            break;
-          }
-        }
-      }
-      numSearches++;
-      if (numSearches >= 6 || foundAll) break;
     }
-
-    note->setStartingCandidatePosition();
+    numSearches++;
+    if (numSearches >= 6 || foundAll) break;
   }
 }
\ No newline at end of file
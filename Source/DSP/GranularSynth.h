@@ -12,7 +12,12 @@
 
 #include <juce_audio_basics/juce_audio_basics.h>
 
+#include "AnalysisCache.h"
+#include "AnalysisThreadPool.h"
+#include "BlockStats.h"
+#include "CandidateTable.h"
 #include "Grain.h"
+#include "GrainEventFifo.h"
 #include "PitchDetector.h"
 #include "../Parameters.h"
 #include "../Utils.h"
@@ -71,6 +76,9 @@ class GranularSynth : public juce::AudioProcessor, juce::MidiKeyboardState::List
 
   void getPresetParamsXml(juce::MemoryBlock& destData);
   void setPresetParamsXml(const void* data, int sizeInBytes);
+  // Loads the audio buffer, spec images and user params of a .gbow file, errorMessage is left empty on success. If
+  // audioParamsOnly is set, only the juce::AudioParam values are applied on top of what is currently loaded
+  void loadPreset(juce::File file, juce::String& errorMessage, bool audioParamsOnly = false);
 
   double getSampleRate() { return mSampleRate; }
   juce::AudioBuffer<float>& getAudioBuffer() { return mAudioBuffer; }
@@ -79,6 +87,16 @@ class GranularSynth : public juce::AudioProcessor, juce::MidiKeyboardState::List
   void setInputBuffer(juce::AudioBuffer<float>* audioBuffer, double sampleRate);
   const juce::AudioBuffer<float>& getInputBuffer() { return mInputBuffer; }
   void processInput(juce::Range<juce::int64> range, bool preset);
+  // Analysis option, used the next time an input is processed
+  void setSpectralWhitening(bool enabled) { mPitchDetector.setSpectralWhitening(enabled); }
+  bool getSpectralWhitening() const { return mPitchDetector.getSpectralWhitening(); }
+  void setNumPitchSegments(int numSegments) { mPitchDetector.setNumActiveSegments(numSegments); }
+  int getNumPitchSegments() const { return mPitchDetector.getNumActiveSegments(); }
+  // Reuse the analysis of audio seen before, on by default
+  void setUseAnalysisCache(bool enabled) { mAnalysisCache.setEnabled(enabled); }
+  // Trimmed selections are cut out of the cached analysis of the whole input when there is one, so only the selection is segmented
+  void setTrimFromFullAnalysis(bool enabled) { mIsTrimFromFullAnalysis = enabled; }
+  bool getTrimFromFullAnalysis() const { return mIsTrimFromFullAnalysis; }
   std::vector<Utils::SpecBuffer*> getProcessedSpecs() {
     return std::vector<Utils::SpecBuffer*>(mProcessedSpecs.begin(), mProcessedSpecs.end());
   }
@@ -88,45 +106,113 @@ class GranularSynth : public juce::AudioProcessor, juce::MidiKeyboardState::List
   ParamGlobal& getParamGlobal() { return mParameters.global; }
   ParamUI& getParamUI() { return mParameters.ui; }
   void resetParameters(bool fullClear = true);
+  // Grains are spawned from a copy of the note candidates, call after changing them outside of the synth
+  void publishCandidates();
   int incrementPosition(int genIdx, bool lookRight);
   
-  double& getLoadingProgress() { return mLoadingProgress; }
-  const juce::Array<Utils::MidiNote>& getMidiNotes() { return mMidiNotes; }
+  double getLoadingProgress() const { return mLoadingProgress; }
+  // Notes held right now, the last one played is last. Built from what the audio thread published, for the UI
+  juce::Array<Utils::MidiNote> getMidiNotes() const;
   std::vector<ParamCandidate*> getActiveCandidates();
-  Utils::PitchClass getLastPitchClass() { return mLastPitchClass; }
+  Utils::PitchClass getLastPitchClass() const { return mLastPitchClass; }
+  // Filled by the audio thread once per block, only one consumer may drain it
+  BlockStatsFifo& getBlockStats() { return mBlockStatsFifo; }
+  GrainEventFifo& getGrainEvents() { return mGrainEventFifo; }
 
  private:
   // DSP constants
-  static constexpr auto FFT_SIZE = 4096;
-  static constexpr auto HOP_SIZE = 4096;  // Larger because don't need high resolution for spectrogram
+  // The spectrogram doesn't need high time resolution, it shows every Nth frame of the pitch detector's spectrum
+  static constexpr auto SPECTROGRAM_HOP_SIZE = 4096;
+  static constexpr auto SPECTROGRAM_FRAME_STEP = SPECTROGRAM_HOP_SIZE / PitchDetector::HOP_SIZE;
   static constexpr double DEFAULT_BPM = 120.0f;
   // Param bounds
   static constexpr auto MIN_RATE_RATIO = .25f;
   static constexpr auto MAX_RATE_RATIO = 1.0f;
   static constexpr auto MIN_CANDIDATE_SALIENCE = 0.5f;
-  static constexpr auto MAX_GRAINS = 20;  // Max grains active at once
 
+  static constexpr auto KEYBOARD_FIFO_SIZE = 64;  // On-screen keyboard notes between blocks, far more than a mouse can play
+  static constexpr auto STEAL_FADE_SEC = 0.005f;  // A stolen voice fades out this fast before its new note starts
+  static constexpr auto FILTER_SILENCE_LEVEL = 1e-5f;  // About -100dB, a generator's filter tail is cut below this
+
+  // Scratch channels used when rendering a single generator for a block
+  enum GenBufferChannel { GRAINS_LEFT, GRAINS_RIGHT, ENVELOPE, COUNT };
+
+  // A voice slot in the preallocated pool. Slots are reused in place so the audio thread never allocates for notes or grains
   typedef struct GrainNote {
-    Utils::PitchClass pitchClass;
-    float velocity;
+    bool isActive = false;
+    Utils::PitchClass pitchClass = Utils::PitchClass::NONE;
+    float velocity = 0.0f;
     int removeTs = -1;
+    juce::uint64 age = 0;  // order the note was started in, used for stealing the oldest voice
+    // While a stolen voice fades out, the note that takes it over once it is silent (NONE if that note was released already)
+    int stealFadeLeft = 0;
+    int stealFadeLength = 0;
+    Utils::PitchClass pendingPitchClass = Utils::PitchClass::NONE;
+    float pendingVelocity = 0.0f;
     std::array<Utils::EnvelopeADSR, NUM_GENERATORS> genAmpEnvs;
-    std::array<juce::Array<Grain>, NUM_GENERATORS> genGrains;  // Active grains for note per generator
-    std::array<float, NUM_GENERATORS> grainTriggers;           // Keeps track of triggering grains from each generator
-    GrainNote(Utils::PitchClass pitchClass, float velocity, Utils::EnvelopeADSR ampEnv)
-        : pitchClass(pitchClass), velocity(velocity) {
+    std::array<GrainBank, NUM_GENERATORS> genGrains;    // Active grains for note per generator
+    std::array<double, NUM_GENERATORS> grainTriggers;  // Sample (in mTotalSamps) the next grain of each generator is due
+
+    void start(Utils::PitchClass newPitchClass, float newVelocity, int noteOnTs, juce::uint64 newAge) {
+      isActive = true;
+      pitchClass = newPitchClass;
+      velocity = newVelocity;
+      removeTs = -1;
+      age = newAge;
+      stealFadeLeft = 0;
+      pendingPitchClass = Utils::PitchClass::NONE;
+      for (GrainBank& grains : genGrains) {
+        grains.clear();
+      }
       // Initialize grain triggering timestamps
-      grainTriggers.fill(-1.0f);  // Trigger first set of grains right away
-      for (int i = 0; i < NUM_GENERATORS; ++i) {
-        genGrains[i].ensureStorageAllocated(MAX_GRAINS);
-        genAmpEnvs[i].noteOn(ampEnv.noteOnTs);  // Set note on for each position as well
+      grainTriggers.fill(noteOnTs);  // Trigger first set of grains right away
+      for (Utils::EnvelopeADSR& ampEnv : genAmpEnvs) {
+        ampEnv.noteOn(noteOnTs);  // Set note on for each position as well
       }
     }
+    // Cutting the grains of a playing voice clicks, so the new note waits for its grains to fade out
+    void steal(Utils::PitchClass newPitchClass, float newVelocity, juce::uint64 newAge, int fadeLength) {
+      if (stealFadeLeft == 0) {
+        stealFadeLeft = fadeLength;
+        stealFadeLength = fadeLength;
+      }
+      pendingPitchClass = newPitchClass;
+      pendingVelocity = newVelocity;
+      removeTs = -1;
+      age = newAge;
+    }
+    bool isStolen() const { return stealFadeLeft > 0; }
+    // Current loudness of the voice, used for stealing the quietest voice
+    float getLevel() const {
+      float level = 0.0f;
+      for (const Utils::EnvelopeADSR& ampEnv : genAmpEnvs) {
+        level = juce::jmax(level, ampEnv.amplitude);
+      }
+      return level * velocity;
+    }
   } GrainNote;
 
   // DSP-preprocessing
-  Fft mFft;
   PitchDetector mPitchDetector;
+  Utils::SpecBuffer mSpectrogram;
+  AnalysisCache mAnalysisCache;
+  juce::SharedResourcePointer<AnalysisThreadPool> mThreadPool;  // Looks up the cache
+  juce::WaitableEvent mAnalysisLoaded{true};                     // Signalled when no cache lookup is running
+  juce::String mAnalysisKey;  // Cache key of the audio being analyzed
+  bool mShouldStoreAnalysis = false;
+  const Utils::SpecBuffer* mAnalysisHpcp = nullptr;  // Every HPCP frame of what was analyzed, owned by the pitch detector
+  // Used when the buffers don't come straight from the pitch detector (loaded from the cache or a trimmed slice)
+  Utils::SpecBuffer mHpcpCopy;
+  Utils::SpecBuffer mPitchSpecCopy;
+  // Trimming from the cached analysis of the whole input
+  bool mIsTrimFromFullAnalysis = true;
+  juce::AudioBuffer<float> mAnalysisBuffer;  // Whole input, only kept until its cache key is computed
+  Utils::SpecBuffer mFullSpectrogram;
+  juce::Range<int> mTrimFrames;  // Analysis frames of the selection, empty when the whole input is used
+  float mTrimPosOffset = 0.0f;   // How far before the selection the first of mTrimFrames starts, as a position ratio
+  // What grains are spawned from, partial candidates go here while the analysis runs so notes play before it is done
+  CandidateTable mCandidateTable;
+  std::vector<ParamCandidate> mPartialCandidates;
 
   // Bookkeeping
   juce::AudioBuffer<float> mInputBuffer;  // incoming buffer from file or other source
@@ -134,22 +220,65 @@ class GranularSynth : public juce::AudioProcessor, juce::MidiKeyboardState::List
   std::array<Utils::SpecBuffer*, ParamUI::SpecType::COUNT> mProcessedSpecs;
   double mSampleRate;
   juce::MidiKeyboardState mKeyboardState;
-  double mLoadingProgress = 0.0;
+  std::atomic<double> mLoadingProgress{0.0};  // Written by the analysis threads
+  juce::AudioBuffer<float> mGenBuffer;  // preallocated scratch space for rendering generators
+  int mMaxBlockSize = 512;
 
   // Grain control
   long mTotalSamps;
-  juce::Array<GrainNote, juce::CriticalSection> mActiveNotes;
-  Utils::PitchClass mLastPitchClass;
-  // Holes all the notes being played. The synth is the only class who will write to it so no need to worrying about multiple
-  // threads writing to it.
-  // Currently the difference between "midiNotes" and "grainNotes" are midi is a subset mainly for the UI
-  juce::Array<Utils::MidiNote> mMidiNotes;
+  // Only ever touched from the audio thread, note on/off from the UI keyboard arrive through mKeyboardFifo
+  std::array<GrainNote, MAX_POLYPHONY> mVoices;
+  int mNumActiveVoices = 0;
+  juce::uint64 mNextVoiceAge = 0;
+  // Set while a generator's filter (on its params, so per pitch class) still has a tail to play after its last grain
+  std::array<std::array<bool, NUM_GENERATORS>, Utils::PitchClass::COUNT> mIsFilterRinging{};
+  // Notes held, written by the audio thread and read by the UI. Counted per pitch class since several octaves can be held
+  std::array<int, Utils::PitchClass::COUNT> mNumNotesHeld{};
+  std::array<std::atomic<bool>, Utils::PitchClass::COUNT> mIsNoteHeld{};
+  std::array<std::atomic<float>, Utils::PitchClass::COUNT> mNoteVelocities{};
+  std::atomic<Utils::PitchClass> mLastPitchClass{Utils::PitchClass::C};
+  // Notes from the on-screen keyboard, pushed from the message thread and drained at the start of each block so the audio thread
+  // never takes the keyboard state's lock
+  typedef struct KeyboardNote {
+    Utils::PitchClass pitchClass;
+    float velocity;
+    bool isNoteOn;
+  } KeyboardNote;
+  juce::AbstractFifo mKeyboardFifo{KEYBOARD_FIFO_SIZE};
+  std::array<KeyboardNote, KEYBOARD_FIFO_SIZE> mKeyboardNotes;
+
+  // Instrumentation
+  BlockStats mBlockStats;  // Built up over the current block then pushed to the fifo
+  BlockStatsFifo mBlockStatsFifo;
+  GrainEventFifo mGrainEventFifo;  // Grains spawned, for the arc spectrogram to draw
 
   // Parameters
   Parameters mParameters;
 
+  void setAudioParamsXml(juce::XmlElement* params);
   void handleNoteOn(juce::MidiKeyboardState* state, int midiChannel, int midiNoteNumber, float velocity) override;
   void handleNoteOff(juce::MidiKeyboardState* state, int midiChannel, int midiNoteNumber, float velocity) override;
-  void handleGrainAddRemove(int blockSize);
+  void handleMidiMessage(const juce::MidiMessage& message);
+  void handleKeyboardNotes();
+  void pushKeyboardNote(int midiNoteNumber, float velocity, bool isNoteOn);
+  // Starts/stops the voice and publishes the held notes for the UI
+  void noteOn(Utils::PitchClass pitchClass, float velocity);
+  void noteOff(Utils::PitchClass pitchClass);
+  void startVoice(Utils::PitchClass pitchClass, float velocity);
+  void stopVoice(Utils::PitchClass pitchClass);
+  GrainNote& findVoiceToSteal();
+  // Adds the grains due in the next numSamples, each delayed to the sample it is due on
+  void spawnGrains(int numSamples);
+  // Samples until a stolen voice is silent or a released voice is done, no more than maxSamples
+  int getSamplesToNextEvent(int maxSamples) const;
+  // Moves the voices past the numSamples just rendered, freeing what finished playing
+  void advanceGrains(int numSamples);
+  void renderGrains(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
   void createCandidates(juce::HashMap<Utils::PitchClass, std::vector<PitchDetector::Pitch>>& detectedPitches);
+  void findCandidates(PitchDetector::PitchMap& detectedPitches, int noteIdx, std::vector<ParamCandidate>& candidates) const;
+  // Everything besides the audio that changes the analysis output, part of the cache key
+  juce::String getAnalysisParams() const;
+  void setTrimmedSpectrogram();
+  // Run on the analysis pool, publishes the cached analysis of the input or starts the pitch detector on a miss
+  void loadAnalysis(juce::Range<juce::int64> range, bool isTrimFromFull, double sampleRate, const juce::String& analysisParams);
 };
\ No newline at end of file
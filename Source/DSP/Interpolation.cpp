@@ -0,0 +1,50 @@
+/*
+  ==============================================================================
+
+    Interpolation.cpp
+
+  ==============================================================================
+*/
+
+#include "Interpolation.h"
+
+namespace Interpolation {
+
+const SincTable SincTable::sInstance;
+
+int SincTable::getBand(float pbRate) {
+  for (int band = 0; band < NUM_BANDS - 1; ++band) {
+    if (pbRate <= BAND_MAX_RATES[band]) return band;
+  }
+  return NUM_BANDS - 1;
+}
+
+SincTable::SincTable() {
+  const float halfWidth = NUM_SINC_TAPS / 2.0f;
+  for (int band = 0; band < NUM_BANDS; ++band) {
+    const float cutoff = PASSBAND / BAND_MAX_RATES[band];
+    for (int phase = 0; phase <= NUM_PHASES; ++phase) {
+      const float frac = phase / (float)NUM_PHASES;
+      float* taps = mTable.data() + (band * (NUM_PHASES + 1) + phase) * NUM_SINC_TAPS;
+      float sum = 0.0f;
+      for (int i = 0; i < NUM_SINC_TAPS; ++i) {
+        // Distance from the read position to the tap
+        const float x = (i - TAPS_BEFORE) - frac;
+        const float sincX = juce::MathConstants<float>::pi * cutoff * x;
+        const float sincValue = (std::abs(sincX) < 1e-6f) ? 1.0f : std::sin(sincX) / sincX;
+        // Blackman window centered on the read position
+        const float windowX = juce::MathConstants<float>::pi * x / halfWidth;
+        const float window =
+            (std::abs(x) >= halfWidth) ? 0.0f : 0.42f + 0.5f * std::cos(windowX) + 0.08f * std::cos(2.0f * windowX);
+        taps[i] = sincValue * window;
+        sum += taps[i];
+      }
+      // Unity gain at DC for every phase
+      for (int i = 0; i < NUM_SINC_TAPS; ++i) {
+        taps[i] /= sum;
+      }
+    }
+  }
+}
+
+}  // namespace Interpolation
@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    Interpolation.h
+
+    Fractional delay kernels used to read grains from the source buffer
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include "../Utils.h"
+
+namespace Interpolation {
+
+// Samples needed around the read position by the largest kernel (sinc)
+static constexpr int NUM_SINC_TAPS = 16;
+static constexpr int TAPS_BEFORE = NUM_SINC_TAPS / 2 - 1;
+static constexpr int TAPS_AFTER = NUM_SINC_TAPS / 2;
+
+// Only used at the edges of the buffer, the index is never more than a few buffer lengths away
+static inline int wrapIndex(int idx, int size) {
+  while (idx >= size) idx -= size;
+  while (idx < 0) idx += size;
+  return idx;
+}
+
+// Reads straight from the buffer, the caller made sure every tap is inside of it
+struct DirectReader {
+  const float* buffer;
+  float operator()(int idx) const { return buffer[idx]; }
+};
+
+// Reads with the buffer looping around on itself
+struct WrappedReader {
+  const float* buffer;
+  int size;
+  float operator()(int idx) const { return buffer[wrapIndex(idx, size)]; }
+};
+
+/**
+ * @brief Windowed sinc polyphase tables. There is one set of phases per band, each band has a lower cutoff so grains pitched up
+ * are low passed before they are resampled instead of aliasing.
+ */
+class SincTable {
+ public:
+  static constexpr int NUM_PHASES = 64;
+  static constexpr int NUM_BANDS = 4;
+
+  static const SincTable& get() { return sInstance; }
+  // Band with a low enough cutoff for the playback rate
+  static int getBand(float pbRate);
+
+  // The NUM_SINC_TAPS coefficients for the taps starting TAPS_BEFORE samples before the read position
+  const float* getTaps(int band, float frac) const {
+    const int phase = static_cast<int>(frac * NUM_PHASES + 0.5f);
+    return mTable.data() + (band * (NUM_PHASES + 1) + phase) * NUM_SINC_TAPS;
+  }
+
+ private:
+  SincTable();
+  // Built when the plugin is loaded so the audio thread never has to
+  static const SincTable sInstance;
+
+  // Highest playback rate each band is made for
+  static constexpr float BAND_MAX_RATES[NUM_BANDS] = {1.0f, 1.25f, 1.5f, 2.0f};
+  static constexpr float PASSBAND = 0.9f;  // Leaves room for the transition band under nyquist
+
+  // Has an extra phase so a fraction that rounds up to 1.0 still has coefficients
+  std::array<float, NUM_BANDS * (NUM_PHASES + 1) * NUM_SINC_TAPS> mTable;
+};
+
+// The kernels on values already read, T is a float or a juce::dsp::SIMDRegister<float> of them
+template <typename T>
+static inline T lerp(T x0, T x1, T t) {
+  return x0 + (x1 - x0) * t;
+}
+
+// 4-point, 3rd-order Hermite (Catmull-Rom)
+template <typename T>
+static inline T hermite(T xm1, T x0, T x1, T x2, T t) {
+  const T c1 = (x1 - xm1) * 0.5f;
+  const T c2 = xm1 - x0 * 2.5f + x1 * 2.0f - x2 * 0.5f;
+  const T c3 = (x2 - xm1) * 0.5f + (x0 - x1) * 1.5f;
+  return ((c3 * t + c2) * t + c1) * t + x0;
+}
+
+template <typename Reader>
+static inline float hermite(const Reader& read, int idx, float t) {
+  return hermite(read(idx - 1), read(idx), read(idx + 1), read(idx + 2), t);
+}
+
+template <typename Reader>
+static inline float sinc(const Reader& read, int idx, float t, int band) {
+  const float* taps = SincTable::get().getTaps(band, t);
+  const int first = idx - TAPS_BEFORE;
+  float sum = 0.0f;
+  for (int i = 0; i < NUM_SINC_TAPS; ++i) {
+    sum += taps[i] * read(first + i);
+  }
+  return sum;
+}
+
+// Value between idx and idx + 1 at fraction t
+template <Utils::InterpolationType type, typename Reader>
+static inline float interpolate(const Reader& read, int idx, float t, int sincBand) {
+  if constexpr (type == Utils::InterpolationType::SINC) {
+    return sinc(read, idx, t, sincBand);
+  } else if constexpr (type == Utils::InterpolationType::HERMITE) {
+    return hermite(read, idx, t);
+  } else {
+    return lerp(read(idx), read(idx + 1), t);
+  }
+}
+
+}  // namespace Interpolation
@@ -20,8 +20,11 @@ PitchDetector::PitchDetector(double startProgress, double endProgress)
       mFft(FFT_SIZE, HOP_SIZE, startProgress, endProgress / 2.0),
       juce::Thread("pitch detector thread") {
   initHarmonicWeights();
+  // Room for the worst case up front so peak picking never allocates on the workers
+  mFrameScratch.resize(mThreadPool->getNumWorkers());
+  for (FrameScratch& scratch : mFrameScratch) scratch.peaks.reserve(FFT_SIZE / 2 + 1);
   mFft.onProcessingComplete = [this](Utils::SpecBuffer& spectrum) {
-    // Runs FFT twice but using custom size suited for the PitchDetector
+    if (onSpectrumReady != nullptr) onSpectrumReady(spectrum);
     stopThread(4000);
     startThread();
   };
@@ -34,19 +37,32 @@ void PitchDetector::process(const juce::AudioBuffer<float>* audioBuffer, double
   cancelProcessing();
   updateProgress(mStartProgress);
   mSampleRate = sampleRate;
+  mIsHpcpReady = false;
+  mSegmentFrames = juce::Range<int>();
   mFft.process(audioBuffer);
 }
 
+void PitchDetector::processHPCP(Utils::SpecBuffer&& hpcp, double sampleRate, juce::Range<int> segmentFrames) {
+  cancelProcessing();
+  updateProgress(mStartProgress);
+  mSampleRate = sampleRate;
+  mHPCP = std::move(hpcp);
+  mIsHpcpReady = true;
+  mSegmentFrames = segmentFrames;
+  startThread();
+}
+
 void PitchDetector::cancelProcessing() {
   mFft.stopThread(4000);
   stopThread(4000);
 }
 
 void PitchDetector::run() {
-  if (!computeHPCP()) return;
+  if (!(mIsHpcpReady ? computeHPCPPeaks() : computeHPCP())) return;
   if (onHarmonicProfileReady != nullptr) onHarmonicProfileReady(mHPCP);
-  if (!segmentPitches()) return;
-  getSegmentedPitchBuffer();
+  if (mSegmentRange.isEmpty() || !segmentPitches(mSegmentRange.getEnd())) return;
+  normalizePitches(mPitchMap, mMaxConfidence);
+  makePitchBuffer(mPitchMap, mSegmentRange.getLength(), mSegmentedPitches);
   updateProgress(mEndProgress);
   if (onPitchesReady != nullptr) onPitchesReady(mPitchMap, mSegmentedPitches);
 }
@@ -54,6 +70,7 @@ void PitchDetector::run() {
 void PitchDetector::clear() {
   mFft.clear(true);
   mPitchMap.clear();
+  mPartialPitchMap.clear();
 }
 
 void PitchDetector::updateProgress(double progress) {
@@ -62,81 +79,122 @@ void PitchDetector::updateProgress(double progress) {
   }
 }
 
-void PitchDetector::getSegmentedPitchBuffer() {
-  mSegmentedPitches.clear();
-  for (int frame = 0; frame < mHPCP.size(); ++frame) {
-    mSegmentedPitches.push_back(std::vector<float>(mHPCP[frame].size(), 0.0f));
-  }
+void PitchDetector::makePitchBuffer(PitchMap& pitchMap, size_t numFrames, Utils::SpecBuffer& pitchBuffer) {
+  pitchBuffer.setSize(numFrames, NUM_HPCP_BINS);
   for (Utils::PitchClass i : Utils::ALL_PITCH_CLASS) {
-    std::vector<Pitch>& pitchVec = mPitchMap.getReference(i);
+    std::vector<Pitch>& pitchVec = pitchMap.getReference(i);
     for (int j = 0; j < pitchVec.size(); ++j) {
       auto pitch = pitchVec[j];
-      auto duration = pitch.duration * mHPCP.size();
-      int frame = pitch.posRatio * (mHPCP.size() - 1);
+      auto duration = pitch.duration * numFrames;
+      int frame = pitch.posRatio * (numFrames - 1);
       int bin = (int)(pitch.pitchClass * (NUM_HPCP_BINS / 12.0));
       for (int j = 0; j < duration; ++j) {
-        mSegmentedPitches[frame + j][bin] = pitch.gain;
+        pitchBuffer[frame + j][bin] = pitch.gain;
       }
     }
   }
 }
 
 bool PitchDetector::computeHPCP() {
-  mHPCP.clear();
-
   const Utils::SpecBuffer& spec = mFft.getSpectrum();
-  for (size_t frame = 0; frame < spec.size(); ++frame) {
-    if (threadShouldExit()) return false;
-    updateProgress(mStartProgress + (mDiffProgress * (static_cast<double>(frame) / static_cast<double>(spec.size()))));
-    mHPCP.push_back(std::vector<float>(NUM_HPCP_BINS, 0.0f));
-
-    const std::vector<float>& specFrame = spec[frame];
-
-    // Find local peaks to compute HPCP with
-    std::vector<PitchDetector::Peak> peaks = getPeaks(MAX_SPEC_PEAKS, specFrame);
-
-    float curMax = 0.0;
-    for (int i = 0; i < peaks.size(); ++i) {
-      if (threadShouldExit()) return false;
-      float peakFreq = ((peaks[i].binNum / (specFrame.size() - 1)) * mSampleRate) / 2;
-      if (peakFreq < MIN_FREQ || peakFreq > MAX_FREQ) continue;
-
-      // Create sum for each pitch class
-      for (int pc = 0; pc < NUM_HPCP_BINS; ++pc) {
-        int pcIdx = (pc + PITCH_CLASS_OFFSET_BINS) % NUM_HPCP_BINS;
-        float centerFreq = REF_FREQ * std::pow(2.0f, pc / (float)NUM_HPCP_BINS);
-
-        // Add contribution from each harmonic
-        for (int hIdx = 0; hIdx < mHarmonicWeights.size(); ++hIdx) {
-          float freq = peakFreq * pow(2., -mHarmonicWeights[hIdx].semitone / 12.0);
-          float harmonicWeight = mHarmonicWeights[hIdx].gain;
-          float d = std::fmod(12.0f * std::log2(freq / centerFreq), 12.0f);
-          if (std::abs(d) <= (0.5f * HPCP_WINDOW_LEN)) {
-            float w = std::pow(std::cos((M_PI * d) / HPCP_WINDOW_LEN), 2.0f);
-            mHPCP[frame][pcIdx] += (w * std::pow(peaks[i].gain, 2) * harmonicWeight * harmonicWeight);
-            if (mHPCP[frame][pcIdx] > curMax) curMax = mHPCP[frame][pcIdx];
-          }
+  mHPCP.setSize(spec.size(), NUM_HPCP_BINS);
+  initHPCPPeaks();
+  mIsWhitening = mWhiteningEnabled;
+  if (mIsWhitening) initWhitening(static_cast<int>(spec.getNumBins()));
+  beginSegmenting();
+  // Each HPCP frame only depends on its own spectrum frame, so they are spread over the analysis pool. Segmenting goes in
+  // order over frames, it follows the finished frames on this thread in the meantime
+  return mThreadPool->parallelFor(
+      static_cast<int>(spec.size()), HPCP_FRAMES_PER_CHUNK,
+      [this](int startFrame, int endFrame, int workerIdx) {
+        for (int frame = startFrame; frame < endFrame; ++frame) {
+          computeHPCPFrame(frame, mFrameScratch[workerIdx]);
         }
-      }
-    }
+      },
+      [this]() { return threadShouldExit(); },
+      [this](double progress) { updateProgress(mStartProgress + (mDiffProgress * progress)); },
+      [this](int numFramesReady) { segmentReadyFrames(numFramesReady); });
+}
 
-    // Normalize HPCP frame and clear low energy frames
-    float totalEnergy = 0.0f;
-    if (curMax > 0.0f) {
-      for (int pc = 0; pc < NUM_HPCP_BINS; ++pc) {
-        totalEnergy += mHPCP[frame][pc];
-        mHPCP[frame][pc] /= curMax;
+void PitchDetector::computeHPCPFrame(int frame, FrameScratch& scratch) {
+  std::span<const float> specFrame = mFft.getSpectrum()[frame];
+  std::span<float> hpcpFrame = mHPCP[frame];
+  std::vector<Peak>& peaks = scratch.peaks;
+
+  // Find local peaks to compute HPCP with
+  getPeaks(MAX_SPEC_PEAKS, specFrame, peaks);
+  if (mIsWhitening) whitenPeaks(specFrame, scratch);
+
+  float curMax = 0.0;
+  for (int i = 0; i < peaks.size(); ++i) {
+    float peakFreq = ((peaks[i].binNum / (specFrame.size() - 1)) * mSampleRate) / 2;
+    if (peakFreq < MIN_FREQ || peakFreq > MAX_FREQ) continue;
+
+    // Position of the peak in (unwrapped) HPCP bins from the reference frequency
+    const float peakBin = 12.0f * HPCP_BINS_PER_SEMITONE * std::log2(peakFreq / REF_FREQ);
+    const float peakGain = peaks[i].gain * peaks[i].gain;
+
+    // Add contribution from each harmonic to the few bins inside the window around it
+    for (const HpcpHarmonic& harmonic : mHpcpHarmonics) {
+      const float centerBin = peakBin - harmonic.binOffset;
+      const int firstBin = static_cast<int>(std::ceil(centerBin - HPCP_WINDOW_BINS));
+      const int lastBin = static_cast<int>(std::floor(centerBin + HPCP_WINDOW_BINS));
+      for (int bin = firstBin; bin <= lastBin; ++bin) {
+        const float tablePos = std::abs(bin - centerBin) * HPCP_WINDOW_TABLE_RES;
+        const int tableIdx = static_cast<int>(tablePos);
+        const float w = mHpcpWindow[tableIdx] + (tablePos - tableIdx) * (mHpcpWindow[tableIdx + 1] - mHpcpWindow[tableIdx]);
+        const int pcIdx = (((bin + PITCH_CLASS_OFFSET_BINS) % NUM_HPCP_BINS) + NUM_HPCP_BINS) % NUM_HPCP_BINS;
+        hpcpFrame[pcIdx] += w * peakGain * harmonic.weight;
+        if (hpcpFrame[pcIdx] > curMax) curMax = hpcpFrame[pcIdx];
       }
     }
-    if (totalEnergy / NUM_HPCP_BINS < MIN_AVG_FRAME_ENERGY) {
-      std::fill(mHPCP[frame].begin(), mHPCP[frame].end(), 0.0f);
+  }
+
+  // Normalize HPCP frame and clear low energy frames
+  float totalEnergy = 0.0f;
+  if (curMax > 0.0f) {
+    for (int pc = 0; pc < NUM_HPCP_BINS; ++pc) {
+      totalEnergy += hpcpFrame[pc];
+      hpcpFrame[pc] /= curMax;
     }
   }
-  return true;
+  if (totalEnergy / NUM_HPCP_BINS < MIN_AVG_FRAME_ENERGY) {
+    std::fill(hpcpFrame.begin(), hpcpFrame.end(), 0.0f);
+  }
+
+  findHPCPPeaks(frame, peaks);
+}
+
+bool PitchDetector::computeHPCPPeaks() {
+  initHPCPPeaks();
+  beginSegmenting();
+  return mThreadPool->parallelFor(
+      static_cast<int>(mHPCP.size()), HPCP_FRAMES_PER_CHUNK,
+      [this](int startFrame, int endFrame, int workerIdx) {
+        for (int frame = startFrame; frame < endFrame; ++frame) {
+          findHPCPPeaks(frame, mFrameScratch[workerIdx].peaks);
+        }
+      },
+      [this]() { return threadShouldExit(); }, nullptr, [this](int numFramesReady) { segmentReadyFrames(numFramesReady); });
+}
+
+void PitchDetector::initHPCPPeaks() {
+  mNumSegments = mNumSegmentsSetting;
+  mHpcpPeaks.resize(mHPCP.size() * MAX_ACTIVE_SEGMENTS);
+  mNumHpcpPeaks.assign(mHPCP.size(), 0);
+}
+
+// Segmenting looks at the HPCP peaks of every frame several times (lookahead), find them once up front
+void PitchDetector::findHPCPPeaks(int frame, std::vector<Peak>& peaks) {
+  getPeaks(mNumSegments, mHPCP[frame], peaks);
+  std::copy(peaks.begin(), peaks.end(), mHpcpPeaks.begin() + (frame * MAX_ACTIVE_SEGMENTS));
+  mNumHpcpPeaks[frame] = static_cast<int>(peaks.size());
 }
 
-bool PitchDetector::segmentPitches() {
-  if (mHPCP.empty()) return false;
+void PitchDetector::beginSegmenting() {
+  mSegmentRange = mSegmentFrames.isEmpty() ? juce::Range<int>(0, static_cast<int>(mHPCP.size()))
+                                           : mSegmentFrames.getIntersectionWith({0, static_cast<int>(mHPCP.size())});
+  mNextSegmentFrame = mSegmentRange.getStart();
 
   mPitchMap.clear();
   for (int i = 0; i < mSegments.size(); ++i) {
@@ -144,71 +202,105 @@ bool PitchDetector::segmentPitches() {
   }
 
   // Initialize parameters
-  int maxIdleFrames = mSampleRate * (MAX_IDLE_TIME_MS / 1000.0) / HOP_SIZE;
-  int minNoteFrames = mSampleRate * (MIN_NOTE_TIME_MS / 1000.0) / HOP_SIZE;
-  float maxConfidence = 0;
+  mMaxIdleFrames = mSampleRate * (MAX_IDLE_TIME_MS / 1000.0) / HOP_SIZE;
+  mMinNoteFrames = mSampleRate * (MIN_NOTE_TIME_MS / 1000.0) / HOP_SIZE;
+  mNumLookaheadFrames = mSampleRate * (LOOKAHEAD_TIME_MS / 1000.0) / HOP_SIZE;
+  mMaxConfidence = 0;
+  mNumPitchesFound = 0;
+  mNumPitchesPublished = 0;
+  mLastPublishMs = juce::Time::getMillisecondCounter() - PARTIAL_PITCHES_INTERVAL_MS;  // First pitches go out right away
+}
+
+void PitchDetector::segmentReadyFrames(int numFramesReady) {
+  // The lookahead reads frames past the one being segmented
+  const int endFrame = (numFramesReady >= static_cast<int>(mHPCP.size())) ? numFramesReady : numFramesReady - mNumLookaheadFrames;
+  if (endFrame <= mNextSegmentFrame || !segmentPitches(endFrame)) return;
+  publishPartialPitches();
+}
+
+bool PitchDetector::segmentPitches(int endFrame) {
+  const int firstFrame = mSegmentRange.getStart();
+  const float numFrames = static_cast<float>(mSegmentRange.getLength());
+  endFrame = juce::jmin(endFrame, mSegmentRange.getEnd());
 
   // Calculate note trajectories through the clip
-  for (int frame = 0; frame < mHPCP.size(); ++frame) {
+  std::array<SegmentMatch, MAX_ACTIVE_SEGMENTS * MAX_ACTIVE_SEGMENTS> matches;
+  for (; mNextSegmentFrame < endFrame; ++mNextSegmentFrame) {
     if (threadShouldExit()) return false;
+    const int frame = mNextSegmentFrame;
     // Get the new pitch candidates
-    std::vector<PitchDetector::Peak> peaks = getPeaks(NUM_ACTIVE_SEGMENTS, mHPCP[frame]);
-
-    // Look for continuation candidates in peaks
-    for (int i = 0; i < mSegments.size(); ++i) {
-      if (!mSegments[i].isAvailable) {
-        int closestIdx = -1;
-        for (int j = 0; j < peaks.size(); ++j) {
-          float devBins = std::abs(mSegments[i].binNum - peaks[j].binNum);
-          if (devBins <= MAX_DEVIATION_BINS) {
-            // Replace candidate if:
-            if (closestIdx == -1) {  // It is the first one
-              closestIdx = j;
-            } else if (devBins < std::abs(mSegments[i].binNum - peaks[closestIdx].binNum) ||  // It is closer to the target
-                       (peaks[closestIdx].binNum == peaks[j].binNum &&
-                        (peaks[closestIdx].gain < peaks[j].gain))) {  // It's tied for distance
-                                                                      // but has a higher gain
-              closestIdx = j;
-            }
-          }
-        }
-        if (closestIdx == -1) {
+    // Copied since peaks are marked as used below
+    std::span<const Peak> framePeaks = getHpcpPeaks(frame);
+    std::array<Peak, MAX_ACTIVE_SEGMENTS> peaks;
+    std::copy(framePeaks.begin(), framePeaks.end(), peaks.begin());
+    const int numPeaks = static_cast<int>(framePeaks.size());
+
+    // Every active segment and peak pair close enough to be a continuation
+    int numMatches = 0;
+    std::array<bool, MAX_ACTIVE_SEGMENTS> wasAvailable;
+    for (int i = 0; i < mNumSegments; ++i) {
+      wasAvailable[i] = mSegments[i].isAvailable;
+      if (mSegments[i].isAvailable) continue;
+      for (int j = 0; j < numPeaks; ++j) {
+        float devBins = std::abs(mSegments[i].binNum - peaks[j].binNum);
+        if (devBins <= MAX_DEVIATION_BINS) matches[numMatches++] = {devBins, peaks[j].gain, i, j};
+      }
+    }
+
+    // Greedy assignment, the closest pairs first (ties go to the higher gain). With a single segment this is simply the
+    // closest peak, and for the handful of segments tracked it is near enough to an optimal matching
+    std::sort(matches.begin(), matches.begin() + numMatches, [](const SegmentMatch& self, const SegmentMatch& other) {
+      return self.cost < other.cost || (self.cost == other.cost && self.gain > other.gain);
+    });
+    std::array<int, MAX_ACTIVE_SEGMENTS> closestIdx;
+    closestIdx.fill(-1);
+    for (int m = 0; m < numMatches; ++m) {
+      const SegmentMatch& match = matches[m];
+      if (closestIdx[match.segmentIdx] != -1 || peaks[match.peakIdx].binNum == INVALID_BIN) continue;
+      closestIdx[match.segmentIdx] = match.peakIdx;
+      peaks[match.peakIdx].binNum = INVALID_BIN;  // Mark peak so it isn't reused for multiple segments
+    }
+
+    for (int i = 0; i < mNumSegments; ++i) {
+      if (!wasAvailable[i]) {
+        if (closestIdx[i] == -1) {
           // Mark segment as waiting for continuance
           if (mSegments[i].idleFrame == -1) mSegments[i].idleFrame = frame;
         } else {
           // Continue segment
+          const Peak& peak = framePeaks[closestIdx[i]];
           mSegments[i].idleFrame = -1;
           // Change bin num to better candidate if needed
-          if (!hasBetterCandidateAhead(frame + 1, mSegments[i].binNum, std::abs(mSegments[i].binNum - peaks[closestIdx].binNum))) {
-            mSegments[i].binNum = peaks[closestIdx].binNum;
+          if (!hasBetterCandidateAhead(frame + 1, mSegments[i].binNum, std::abs(mSegments[i].binNum - peak.binNum))) {
+            mSegments[i].binNum = peak.binNum;
           }
-          mSegments[i].salience += peaks[closestIdx].gain;
-          peaks[closestIdx].binNum = INVALID_BIN;  // Mark peak so it isn't reused for multiple
-                                                   // segments
+          mSegments[i].salience += peak.gain;
         }
 
         // Check for segment expiration
-        if (mSegments[i].idleFrame > 0 && (frame - mSegments[i].idleFrame) > maxIdleFrames) {
+        if (mSegments[i].idleFrame > 0 && (frame - mSegments[i].idleFrame) > mMaxIdleFrames) {
           Utils::PitchClass pc = getPitchClass(mSegments[i].binNum);
-          if (frame - mSegments[i].startFrame > minNoteFrames) {
+          if (frame - mSegments[i].startFrame > mMinNoteFrames) {
             // Push to completed segments
             float confidence = mSegments[i].salience / (frame - mSegments[i].startFrame);
-            if (confidence > maxConfidence) maxConfidence = confidence;
-            mPitchMap.getReference(pc).push_back(Pitch(pc, (float)mSegments[i].startFrame / mHPCP.size(),
-                                                      (float)(frame - mSegments[i].startFrame) / mHPCP.size(), confidence));
+            if (confidence > mMaxConfidence) mMaxConfidence = confidence;
+            mPitchMap.getReference(pc).push_back(Pitch(pc, (mSegments[i].startFrame - firstFrame) / numFrames,
+                                                      (frame - mSegments[i].startFrame) / numFrames, confidence));
+            mNumPitchesFound++;
           }
           // Replace segment with new peak
           mSegments[i].isAvailable = true;
         }
       } else {
-        // Replace segment with new peak
-        for (int j = 0; j < peaks.size(); ++j) {
-          if (peaks[j].binNum != INVALID_BIN) {
+        // Replace segment with the strongest unused peak
+        for (int j = 0; j < numPeaks; ++j) {
+          if (peaks[j].binNum != INVALID_BIN && peaks[j].gain >= MIN_NEW_SEGMENT_GAIN) {
             mSegments[i].startFrame = frame;
             mSegments[i].idleFrame = -1;
             mSegments[i].binNum = peaks[j].binNum;
             mSegments[i].salience = peaks[j].gain;
             mSegments[i].isAvailable = false;
+            peaks[j].binNum = INVALID_BIN;
             break;
           }
         }
@@ -216,25 +308,42 @@ bool PitchDetector::segmentPitches() {
     }
   }
 
+  return true;
+}
+
+void PitchDetector::publishPartialPitches() {
+  if (onPartialPitchesReady == nullptr || mNumPitchesFound == mNumPitchesPublished) return;
+  const juce::uint32 nowMs = juce::Time::getMillisecondCounter();
+  if (nowMs - mLastPublishMs < PARTIAL_PITCHES_INTERVAL_MS) return;
+  mLastPublishMs = nowMs;
+  mNumPitchesPublished = mNumPitchesFound;
+
+  // Copied since segmenting keeps adding to mPitchMap with the raw confidences
+  mPartialPitchMap.clear();
+  for (Utils::PitchClass i : Utils::ALL_PITCH_CLASS) {
+    mPartialPitchMap.set(i, mPitchMap.getReference(i));
+  }
+  normalizePitches(mPartialPitchMap, mMaxConfidence);
+  onPartialPitchesReady(mPartialPitchMap);
+}
+
+void PitchDetector::normalizePitches(PitchMap& pitchMap, float maxConfidence) {
   // Normalize pitch saliences
   for (Utils::PitchClass i : Utils::ALL_PITCH_CLASS) {
-    std::vector<Pitch>& pitchVec = mPitchMap.getReference(i);
+    std::vector<Pitch>& pitchVec = pitchMap.getReference(i);
     for (int j = 0; j < pitchVec.size(); ++j) {
       pitchVec[j].gain /= maxConfidence;
     }
     // Sort pitches from high to low salience
     std::sort(pitchVec.begin(), pitchVec.end(), [](Pitch self, Pitch other) { return self.gain > other.gain; });
   }
-  return true;
 }
 
 bool PitchDetector::hasBetterCandidateAhead(int startFrame, float target, float deviation) {
-  int numLookaheadFrames = mSampleRate * (LOOKAHEAD_TIME_MS / 1000.0) / HOP_SIZE;
-  for (int i = startFrame; i < startFrame + numLookaheadFrames; ++i) {
-    if (i > mHPCP.size() - 1) return false;
-    std::vector<PitchDetector::Peak> peaks = getPeaks(NUM_ACTIVE_SEGMENTS, mHPCP[i]);
-    for (int j = 0; j < peaks.size(); ++j) {
-      float peakDev = std::abs(target - peaks[j].binNum);
+  for (int i = startFrame; i < startFrame + mNumLookaheadFrames; ++i) {
+    if (i >= mSegmentRange.getEnd()) return false;
+    for (const Peak& peak : getHpcpPeaks(i)) {
+      float peakDev = std::abs(target - peak.binNum);
       if (peakDev < deviation) return true;
     }
   }
@@ -297,14 +406,69 @@ void PitchDetector::initHarmonicWeights() {
       (*it).gain += (1.0 / octweight);
     }
   }
+
+  // Everything the HPCP inner loop needs that doesn't depend on the audio
+  mHpcpHarmonics.clear();
+  for (const HarmonicWeight& harmonicWeight : mHarmonicWeights) {
+    mHpcpHarmonics.push_back({harmonicWeight.semitone * HPCP_BINS_PER_SEMITONE, harmonicWeight.gain * harmonicWeight.gain});
+  }
+  for (int i = 0; i < mHpcpWindow.size(); ++i) {
+    const double distanceSemitones = (i / static_cast<double>(HPCP_WINDOW_TABLE_RES)) / HPCP_BINS_PER_SEMITONE;
+    // Past the window (only the final interpolation point) contributes nothing
+    mHpcpWindow[i] = (distanceSemitones <= 0.5 * HPCP_WINDOW_LEN)
+                         ? static_cast<float>(std::pow(std::cos((M_PI * distanceSemitones) / HPCP_WINDOW_LEN), 2.0))
+                         : 0.0f;
+  }
 }
 
-std::vector<PitchDetector::Peak> PitchDetector::getPeaks(int numPeaks, const std::vector<float>& frame) {
+// Band layout of the whitening noise envelope, from essentia's SpectralWhitening
+void PitchDetector::initWhitening(int specSize) {
+  const float spectralRange = mSampleRate / 2.0f;
+  mWhiteningFreqs.clear();
+  mWhiteningBands.clear();
+  mWhiteningWeights.clear();
+  mWhiteningNumBins = 0;
+  for (float freq = 0.0; freq <= MAX_FREQ && freq <= spectralRange; freq += BPF_RESOLUTION) {
+    float bf = freq - std::max(50.0, freq * 0.34);  // 0.66
+    float ef = freq + std::max(50.0, freq * 0.58);  // 1.58
+    int b = int(bf / spectralRange * (specSize - 1.0) + 0.5);
+    int e = int(ef / spectralRange * (specSize - 1.0) + 0.5);
+    b = std::max(b, 0);
+    b = std::min(specSize - 1, b);
+    e = std::max(e, b + 1);
+    e = std::min(specSize, e);
+    float c = b / 2.0 + e / 2.0;
+    float halfwindowlength = e - c;
+
+    mWhiteningBands.push_back({b, e - b, static_cast<int>(mWhiteningWeights.size())});
+    for (int i = b; i < e; ++i) {
+      float weight = 1.0 - std::abs(float(i) - c) / halfwindowlength;
+      weight *= weight;
+      weight *= weight;
+      mWhiteningWeights.push_back(weight);
+    }
+    mWhiteningFreqs.push_back(freq);
+    mWhiteningNumBins = std::max(mWhiteningNumBins, e);
+  }
+
+  // The envelope needs at least two points, only happens at absurdly low sample rates
+  if (mWhiteningFreqs.size() < 2) {
+    mIsWhitening = false;
+    return;
+  }
+  for (FrameScratch& scratch : mFrameScratch) {
+    scratch.energy.resize(mWhiteningNumBins);
+    scratch.energySquared.resize(mWhiteningNumBins);
+    scratch.envelopeDb.resize(mWhiteningFreqs.size());
+  }
+}
+
+void PitchDetector::getPeaks(int numPeaks, std::span<const float> frame, std::vector<Peak>& peaks) const {
   int size = frame.size();
   const float scale = 1.0 / (float)(size - 1);
 
-  std::vector<Peak> peaks;
-  peaks.reserve(size);
+  // Reused between frames, so once the capacity has grown this doesn't allocate
+  peaks.clear();
 
   // we want to round up to the next integer instead of simple truncation,
   // otherwise the peak frequency at i can be lower than _minPos
@@ -373,110 +537,64 @@ std::vector<PitchDetector::Peak> PitchDetector::getPeaks(int numPeaks, const std
     }
   }
 
-  // we only want this many peaks
-  int nWantedPeaks = juce::jmin(numPeaks, (int)peaks.size());
-  std::sort(peaks.begin(), peaks.end(), [](Peak self, Peak other) { return self.gain > other.gain; });
-  return std::vector<Peak>(peaks.begin(), peaks.begin() + nWantedPeaks);
+  // we only want this many peaks, strongest first. Only the wanted ones need to end up sorted
+  const int nWantedPeaks = juce::jmin(numPeaks, (int)peaks.size());
+  const auto byGain = [](const Peak& self, const Peak& other) { return self.gain > other.gain; };
+  std::nth_element(peaks.begin(), peaks.begin() + nWantedPeaks, peaks.end(), byGain);
+  peaks.resize(nWantedPeaks);
+  std::sort(peaks.begin(), peaks.end(), byGain);
 }
 
-std::vector<PitchDetector::Peak> PitchDetector::getWhitenedPeaks(int numPeaks, const std::vector<float>& frame) {
-  std::vector<Peak> peaks = getWhitenedPeaks(numPeaks, frame);
-  const int nPeaks = peaks.size();
-
-  // If there are no magnitudes to whiten, do nothing
-  if (nPeaks == 0) {
-    return peaks;
-  }
-
-  // Convert input linear magnitudes to dB scale
-  for (int i = 0; i < nPeaks; ++i) {
-    peaks[i].gain = float(2.0) * Utils::lin2db(peaks[i].gain);
-  }
-
-  // get max peak
-  float maxAmp = peaks.front().gain;
-  float spectralRange = mSampleRate / 2.0f;
-
-  // compute envelope
-  std::vector<float> xPointsNoiseBPF;
-  std::vector<float> yPointsNoiseBPF;
-
-  float incr = BPF_RESOLUTION;
-  int specSize = frame.size();
-  // reserve some meaningful space, i.e. size of sepctrum
-  xPointsNoiseBPF.reserve(specSize);
-  yPointsNoiseBPF.reserve(specSize);
-  for (float freq = 0.0; freq <= MAX_FREQ && freq <= spectralRange; freq += incr) {  //# magic numbers in the body of this for loop
-    float bf = freq - std::max(50.0, freq * 0.34);                                   // 0.66
-    float ef = freq + std::max(50.0, freq * 0.58);                                   // 1.58
-    int b = int(bf / spectralRange * (specSize - 1.0) + 0.5);
-    int e = int(ef / spectralRange * (specSize - 1.0) + 0.5);
-    b = std::max(b, 0);
-    b = std::min(specSize - 1, b);
-    e = std::max(e, b + 1);
-    e = std::min(specSize, e);
-    float c = b / 2.0 + e / 2.0;
-    float halfwindowlength = e - c;
-
-    float n = 0.0;
-    float wavg = 0.0;
-
-    for (int i = b; i < e; ++i) {
-      float weight = 1.0 - abs(float(i) - c) / halfwindowlength;
-      weight *= weight;
-      weight *= weight;
-      float spectrumEnergyVal = frame[i] * frame[i];
-      weight *= spectrumEnergyVal;
-      wavg += spectrumEnergyVal * weight;
-      n += weight;
+void PitchDetector::whitenPeaks(std::span<const float> frame, FrameScratch& scratch) const {
+  std::vector<Peak>& peaks = scratch.peaks;
+  if (peaks.empty()) return;
+
+  // Noise envelope, a weighted average of the energy in each band
+  juce::FloatVectorOperations::multiply(scratch.energy.data(), frame.data(), frame.data(), mWhiteningNumBins);
+  juce::FloatVectorOperations::multiply(scratch.energySquared.data(), scratch.energy.data(), scratch.energy.data(),
+                                        mWhiteningNumBins);
+  const int numPoints = static_cast<int>(mWhiteningBands.size());
+  for (int i = 0; i < numPoints; ++i) {
+    const WhiteningBand& band = mWhiteningBands[i];
+    const float* weights = mWhiteningWeights.data() + band.weightIdx;
+    const float* energy = scratch.energy.data() + band.startBin;
+    const float* energySquared = scratch.energySquared.data() + band.startBin;
+    float n = 0.0f;
+    float wavg = 0.0f;
+    for (int j = 0; j < band.numBins; ++j) {
+      n += weights[j] * energy[j];
+      wavg += weights[j] * energySquared[j];
     }
-    if (n != 0.0) wavg /= n;
-
-    // Add points to the BPFs
-    xPointsNoiseBPF.push_back(freq);
-    yPointsNoiseBPF.push_back(wavg);
+    scratch.envelopeDb[i] = (n != 0.0f) ? wavg / n : 0.0f;
   }
-
-  yPointsNoiseBPF[yPointsNoiseBPF.size() - 1] = yPointsNoiseBPF[yPointsNoiseBPF.size() - 2];
-
-  for (int i = 0; i < int(yPointsNoiseBPF.size()); ++i) {
-    // don't optimise the sqrt as 0.5 outside lin2db as it fails for the case
-    // 0, due to previously converted magnitudes to db
-    yPointsNoiseBPF[i] = float(2.0) * Utils::lin2db(sqrt(yPointsNoiseBPF[i]));
+  scratch.envelopeDb[numPoints - 1] = scratch.envelopeDb[numPoints - 2];
+  for (int i = 0; i < numPoints; ++i) {
+    // don't optimise the sqrt as 0.5 outside lin2db as it fails for the case 0
+    scratch.envelopeDb[i] = 2.0f * Utils::lin2db(std::sqrt(scratch.envelopeDb[i]));
   }
-
-  Utils::BPF noiseBPF = Utils::BPF(xPointsNoiseBPF, yPointsNoiseBPF);
-
-  // compute envelope and peak difference to it
-  std::vector<Peak> whitePeaks = peaks;
-  for (int i = 0; i < nPeaks; ++i) {  //# lots of magic values below
-    float freq = ((peaks[i].binNum / (frame.size() - 1)) * mSampleRate) / 2;
-    float amp = peaks[i].gain;
-
-    if (freq > MAX_FREQ - incr) {
-      // Keep current gain
-      continue;  // This used to be a break-statement, but a break-statement
-                 // would only work if the "frequencies" and "magnitudesdB"
-                 // vectors were ordered by frequency
+  scratch.noiseBPF.init(mWhiteningFreqs, scratch.envelopeDb);
+
+  // Peak difference to the envelope in dB, peaks too close to the top of the envelope keep their gain
+  const float maxWhitenFreq = mWhiteningFreqs.back() - BPF_RESOLUTION;
+  float maxGain = 0.0f;
+  float maxWhiteGain = 0.0f;
+  for (Peak& peak : peaks) {
+    maxGain = juce::jmax(maxGain, peak.gain);
+    const float freq = ((peak.binNum / (frame.size() - 1)) * mSampleRate) / 2;
+    if (freq <= maxWhitenFreq) {
+      const float whiteDb = 2.0f * Utils::lin2db(peak.gain) - scratch.noiseBPF(freq);
+      // dividing by 2 due to converting to db => sqrt(lin2db(A)) lin2db(A/2)
+      peak.gain = Utils::db2lin(whiteDb / 2.0f);
     }
-
-    float ampEnv = noiseBPF(freq);
-    if (amp < maxAmp - 40.0) whitePeaks[i].gain = (maxAmp - 40.0 - amp) / 2.0;
-    if (amp > ampEnv)
-      whitePeaks[i].gain = 0.0;
-    else if (amp > ampEnv - 30.0)
-      whitePeaks[i].gain = amp - ampEnv;
-    else
-      whitePeaks[i].gain = -200.0;
-    whitePeaks[i].gain -= 20.0 * freq / 4000.0;
+    maxWhiteGain = juce::jmax(maxWhiteGain, peak.gain);
   }
 
-  // Convert the whitened magnitudes back to linear scale
-  for (int i = 0; i < nPeaks; ++i) {
-    // dividing by 2 due to converting to db => sqrt(lin2db(A)) lin2db(A/2)
-    whitePeaks[i].gain = Utils::db2lin(whitePeaks[i].gain / 2.0);
+  // Only the peaks relative to each other should change, keep the loudest where it was so the low energy frame check
+  // still sees quiet frames as quiet
+  if (maxWhiteGain > 0.0f) {
+    const float scale = maxGain / maxWhiteGain;
+    for (Peak& peak : peaks) peak.gain *= scale;
   }
-  return whitePeaks;
 }
 
 /**
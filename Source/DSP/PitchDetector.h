@@ -36,6 +36,12 @@ class PitchDetector : juce::Thread {
  public:
   static constexpr auto MIN_MIDINOTE = 43;
   static constexpr auto MAX_MIDINOTE = 91;
+  // The one STFT pass done on load, other analysis reuses it through onSpectrumReady
+  static constexpr auto FFT_SIZE = 4096;
+  static constexpr auto HOP_SIZE = 512;
+  // Concurrent pitches tracked, 1 follows a single melodic line
+  static constexpr auto MAX_ACTIVE_SEGMENTS = 6;
+  static constexpr auto POLYPHONIC_SEGMENTS = 4;  // Used when polyphonic tracking is turned on from the UI
 
   PitchDetector(double startProgress, double endProgress);
   ~PitchDetector();
@@ -52,21 +58,34 @@ class PitchDetector : juce::Thread {
 
   typedef juce::HashMap<Utils::PitchClass, std::vector<Pitch>> PitchMap;
 
+  // Called from the FFT thread before pitch detection starts, the spectrum is released once the pitches are ready
+  std::function<void(const Utils::SpecBuffer& spectrum)> onSpectrumReady = nullptr;
   std::function<void(Utils::SpecBuffer& hpcp)> onHarmonicProfileReady = nullptr;
   std::function<void(PitchMap& pitchMap, Utils::SpecBuffer& pitchSpec)> onPitchesReady = nullptr;
+  // Called from the detector thread every so often while segmenting, with the pitches found so far normalized and sorted
+  // like onPitchesReady's. Later calls only add pitches, the gains can still shift as stronger ones are found
+  std::function<void(PitchMap& pitchMap)> onPartialPitchesReady = nullptr;
   std::function<void(double progress)> onProgressUpdated = nullptr;
 
   void process(const juce::AudioBuffer<float>* audioBuffer, double sampleRate);
+  // Skips the FFT and HPCP and only segments, for an HPCP kept from an earlier process(). If segmentFrames is set only those
+  // HPCP frames are segmented into pitches, positions are then relative to the range. The HPCP callback still gets every frame
+  void processHPCP(Utils::SpecBuffer&& hpcp, double sampleRate, juce::Range<int> segmentFrames = {});
+  // Whitens the spectral peaks against their noise envelope before the HPCP, picked up by the next process()
+  void setSpectralWhitening(bool enabled) { mWhiteningEnabled = enabled; }
+  bool getSpectralWhitening() const { return mWhiteningEnabled; }
+  // Number of pitches tracked at once (1 to MAX_ACTIVE_SEGMENTS), picked up by the next process()
+  void setNumActiveSegments(int numSegments) { mNumSegmentsSetting = juce::jlimit(1, MAX_ACTIVE_SEGMENTS, numSegments); }
+  int getNumActiveSegments() const { return mNumSegmentsSetting; }
   void cancelProcessing();
 
   void run() override;
+  // Draws the detected pitches over numFrames HPCP frames, what onPitchesReady hands over as pitchSpec
+  static void makePitchBuffer(PitchMap& pitchMap, size_t numFrames, Utils::SpecBuffer& pitchBuffer);
   // Clear any data not used after lifetime of run()
   void clear();
 
  private:
-  // FFT
-  static constexpr auto FFT_SIZE = 4096;
-  static constexpr auto HOP_SIZE = 512;
   // Spectral Whitening
   static constexpr auto BPF_RESOLUTION = 100.0;
   static constexpr auto MIN_AVG_FRAME_ENERGY = 0.0001;
@@ -82,14 +101,20 @@ class PitchDetector : juce::Thread {
   static constexpr auto MAGNITUDE_THRESHOLD = 0.00001;
   static constexpr auto PITCH_CLASS_OFFSET = 9;  // Offset from reference freq A to lowest class C
   static constexpr auto PITCH_CLASS_OFFSET_BINS = (NUM_HPCP_BINS / Utils::PitchClass::COUNT) * PITCH_CLASS_OFFSET;
+  static constexpr auto HPCP_FRAMES_PER_CHUNK = 32;  // Frames handed to a pool worker at a time
+  static constexpr auto HPCP_BINS_PER_SEMITONE = NUM_HPCP_BINS / 12;
+  // Only bins within half the window of a peak get any of its energy
+  static constexpr int HPCP_WINDOW_BINS = static_cast<int>(0.5f * HPCP_WINDOW_LEN * HPCP_BINS_PER_SEMITONE);
+  static constexpr auto HPCP_WINDOW_TABLE_RES = 64;  // Window table entries per HPCP bin
   // Pitch segmenting
-  static constexpr auto NUM_ACTIVE_SEGMENTS = 1;
+  static constexpr auto MIN_NEW_SEGMENT_GAIN = 0.3f;  // Weaker HPCP peaks (the strongest is 1) only continue pitches
   static constexpr auto MAX_DEVIATION_CENTS = 15;
   static constexpr auto INVALID_BIN = -1;
   static constexpr int MAX_DEVIATION_BINS = (NUM_HPCP_BINS / Utils::PitchClass::COUNT) * (MAX_DEVIATION_CENTS / 100.0);
   static constexpr auto MAX_IDLE_TIME_MS = 62.5;
   static constexpr auto MIN_NOTE_TIME_MS = 125;
   static constexpr auto LOOKAHEAD_TIME_MS = 25;
+  static constexpr auto PARTIAL_PITCHES_INTERVAL_MS = 250;
 
   // Used to show far along the run thread is
   void updateProgress(double progress);
@@ -120,28 +145,100 @@ class PitchDetector : juce::Thread {
   } HarmonicWeight;
 
   Fft mFft;
+  juce::SharedResourcePointer<AnalysisThreadPool> mThreadPool;
   double mSampleRate;
   // HPCP fields
   std::vector<HarmonicWeight> mHarmonicWeights;
+  // Harmonic weights converted for the HPCP inner loop, offset in HPCP bins and the squared weight
+  typedef struct HpcpHarmonic {
+    float binOffset;
+    float weight;
+  } HpcpHarmonic;
+  std::vector<HpcpHarmonic> mHpcpHarmonics;
+  // cos^2 HPCP window by distance from the peak in HPCP bins, sampled HPCP_WINDOW_TABLE_RES times per bin
+  std::array<float, HPCP_WINDOW_BINS * HPCP_WINDOW_TABLE_RES + 2> mHpcpWindow;
+  // Spectral whitening, the noise envelope is a BPF with a point every BPF_RESOLUTION Hz. Each point is a weighted
+  // average of the spectrum energy over a band around it, the band weights only depend on the sample rate
+  typedef struct WhiteningBand {
+    int startBin;
+    int numBins;
+    int weightIdx;  // Start of the band in mWhiteningWeights
+  } WhiteningBand;
+  std::atomic<bool> mWhiteningEnabled{false};
+  bool mIsWhitening = false;  // mWhiteningEnabled for the current run
+  std::vector<float> mWhiteningFreqs;
+  std::vector<WhiteningBand> mWhiteningBands;
+  std::vector<float> mWhiteningWeights;
+  int mWhiteningNumBins = 0;  // Spectrum bins covered by any band
+  // Working space for a single frame, one per analysis pool worker
+  typedef struct FrameScratch {
+    std::vector<Peak> peaks;
+    std::vector<float> energy;
+    std::vector<float> energySquared;
+    std::vector<float> envelopeDb;
+    Utils::BPF noiseBPF;
+  } FrameScratch;
+  std::vector<FrameScratch> mFrameScratch;
+  // Strongest mNumSegments peaks of each HPCP frame, MAX_ACTIVE_SEGMENTS apart
+  std::vector<Peak> mHpcpPeaks;
+  std::vector<int> mNumHpcpPeaks;
   Utils::SpecBuffer mHPCP;  // harmonic pitch class profile
 
   // Pitch segments in buffer form
   Utils::SpecBuffer mSegmentedPitches;
-  std::array<PitchSegment, NUM_ACTIVE_SEGMENTS> mSegments;
+  std::atomic<int> mNumSegmentsSetting{1};
+  int mNumSegments = 1;  // mNumSegmentsSetting for the current run
+  std::array<PitchSegment, MAX_ACTIVE_SEGMENTS> mSegments;
+  bool mIsHpcpReady = false;        // Set by processHPCP()
+  juce::Range<int> mSegmentFrames;  // As requested, empty for all frames
+  juce::Range<int> mSegmentRange;   // Frames actually segmented in this run
+  // Segmenting runs while the HPCP is still being computed, so its progress is kept between calls
+  int mNextSegmentFrame = 0;
+  int mMaxIdleFrames = 0;
+  int mMinNoteFrames = 0;
+  int mNumLookaheadFrames = 0;
+  float mMaxConfidence = 0.0f;
+  int mNumPitchesFound = 0;
+  int mNumPitchesPublished = 0;  // Pitches found when onPartialPitchesReady was last called
+  juce::uint32 mLastPublishMs = 0;
+  // A segment and a peak close enough to continue it, cost is the distance in bins
+  typedef struct SegmentMatch {
+    float cost;
+    float gain;
+    int segmentIdx;
+    int peakIdx;
+  } SegmentMatch;
 
   // Hashmap of detected pitches
   PitchMap mPitchMap;
+  PitchMap mPartialPitchMap;  // Normalized copy handed to onPartialPitchesReady
 
   bool computeHPCP();
-  bool segmentPitches();
-  void getSegmentedPitchBuffer();
+  bool computeHPCPPeaks();  // Only the peaks cache of mHPCP, for when the HPCP came from processHPCP()
+  void initHPCPPeaks();
+  void findHPCPPeaks(int frame, std::vector<Peak>& peaks);
+  // Safe to call for different frames in parallel, scratch is owned by the calling worker
+  void computeHPCPFrame(int frame, FrameScratch& scratch);
+  void beginSegmenting();
+  // Segments up to endFrame (clamped to mSegmentRange), continuing from where the last call stopped
+  bool segmentPitches(int endFrame);
+  // Passed to the HPCP parallelFor, segments as far as the lookahead allows with the first numFramesReady frames done
+  void segmentReadyFrames(int numFramesReady);
+  void publishPartialPitches();
+  static void normalizePitches(PitchMap& pitchMap, float maxConfidence);
   bool hasBetterCandidateAhead(int startFrame, float target,
                                float deviation);  // True if a closer target is ahead
   Utils::PitchClass getPitchClass(float binNum);  // Finds the closest pitch class
   Peak interpolatePeak(int frame, int bin);
   void interpolatePeak(const float leftVal, const float middleVal, const float rightVal, int currentBin, float& resultVal,
                        float& resultBin) const;
-  std::vector<Peak> getPeaks(int numPeaks, const std::vector<float>& frame);
-  std::vector<Peak> getWhitenedPeaks(int numPeaks, const std::vector<float>& frame);
+  // Fills peaks with up to numPeaks of the strongest peaks in frame, sorted by gain
+  void getPeaks(int numPeaks, std::span<const float> frame, std::vector<Peak>& peaks) const;
+  std::span<const Peak> getHpcpPeaks(int frame) const {
+    return {mHpcpPeaks.data() + (frame * MAX_ACTIVE_SEGMENTS), static_cast<size_t>(mNumHpcpPeaks[frame])};
+  }
+  // Rescales scratch.peaks of the frame by how far they stand out of the noise envelope
+  void whitenPeaks(std::span<const float> frame, FrameScratch& scratch) const;
   void initHarmonicWeights();
+  void initWhitening(int specSize);
 };
\ No newline at end of file
@@ -15,22 +15,21 @@
 #include <limits.h>
 
 TransientDetector::TransientDetector(double startProgress, double endProgress)
-    : mStartProgress(startProgress / 2.0),
+    : mStartProgress(startProgress),
       mEndProgress(endProgress),
       mDiffProgress(mEndProgress - mStartProgress),
-      mFft(FFT_SIZE, HOP_SIZE, startProgress, endProgress / 2.0),
-      juce::Thread("transient thread") {
-  mFft.onProcessingComplete = [this](Utils::SpecBuffer& spectrum) {
-    stopThread(4000);
-    startThread();
-  };
-}
+      juce::Thread("transient thread") {}
 
 TransientDetector::~TransientDetector() { stopThread(2000); }
 
-void TransientDetector::process(const juce::AudioBuffer<float>* audioBuffer) { mFft.process(audioBuffer); }
+void TransientDetector::process(const Utils::SpecBuffer* spectrum) {
+  stopThread(4000);
+  mSpectrum = spectrum;
+  startThread();
+}
 
 void TransientDetector::run() {
+  if (mSpectrum == nullptr) return;
   retrieveTransients();
   if (onTransientsUpdated != nullptr && !threadShouldExit()) {
     onTransientsUpdated(mTransients);
@@ -45,7 +44,7 @@ void TransientDetector::updateProgress(double progress) {
 
 void TransientDetector::retrieveTransients() {
   // Perform transient detection on each frame
-  const Utils::SpecBuffer& spec = mFft.getSpectrum();
+  const Utils::SpecBuffer& spec = *mSpectrum;
   mTransients.clear();
   mEnergyBuffer.fill(0.0f);
   for (size_t frame = 0; frame < spec.size(); ++frame) {
@@ -61,8 +60,8 @@ void TransientDetector::retrieveTransients() {
     }
 
     // Accumulate frame energy
-    for (int i = 0; i < FFT_SIZE / 2; ++i) {
-      mEnergyBuffer[0] += spec[frame][i];
+    for (float magnitude : spec[frame]) {
+      mEnergyBuffer[0] += magnitude;
     }
 
     // Check energy threshold
@@ -16,7 +16,7 @@
 #pragma once
 
 #include <juce_core/juce_core.h>
-#include "Fft.h"
+#include "../Utils.h"
 
 class TransientDetector : juce::Thread {
  public:
@@ -32,13 +32,13 @@ class TransientDetector : juce::Thread {
   std::function<void(std::vector<Transient>&)> onTransientsUpdated = nullptr;
   std::function<void(double progress)> onProgressUpdated = nullptr;
 
-  void process(const juce::AudioBuffer<float>* audioBuffer);
+  // Runs over an already computed spectrum (see PitchDetector::onSpectrumReady), it must stay alive until
+  // onTransientsUpdated is called
+  void process(const Utils::SpecBuffer* spectrum);
 
   void run() override;
 
  private:
-  static constexpr auto FFT_SIZE = 1024;
-  static constexpr auto HOP_SIZE = 512;
   static constexpr auto PARAM_THRESHOLD = 2.5f;
   static constexpr auto PARAM_SPREAD = 3;
   static constexpr auto PARAM_ATTACK_LOCK = 10;
@@ -49,7 +49,7 @@ class TransientDetector : juce::Thread {
   double mEndProgress;
   double mDiffProgress;
 
-  Fft mFft;
+  const Utils::SpecBuffer* mSpectrum = nullptr;
   std::array<float, PARAM_SPREAD> mEnergyBuffer;  // Spectral energy rolling buffer
   std::vector<Transient> mTransients;
   int mAttackFrames = PARAM_ATTACK_LOCK;
@@ -10,6 +10,69 @@
 
 #include "Parameters.h"
 
+namespace {
+// Owns every table ever built, only freed when the plugin is unloaded
+struct GrainEnvelopeStorage {
+  ~GrainEnvelopeStorage() {
+    for (std::atomic<float*>& table : tables) {
+      delete[] table.load();
+    }
+  }
+  std::array<std::atomic<float*>, GrainEnvelopeTables::NUM_KEYS> tables{};
+};
+
+GrainEnvelopeStorage& getGrainEnvelopeStorage() {
+  static GrainEnvelopeStorage storage;
+  return storage;
+}
+}  // namespace
+
+int GrainEnvelopeTables::getKey(float shape, float tilt) {
+  /* LUT divided into 3 parts
+
+               1.0
+              -----
+     rampUp  /     \  rampDown
+            /       \
+  */
+  float scaledShape = (shape * ENV_LUT_SIZE) / 2.0f;
+  float scaledTilt = tilt * ENV_LUT_SIZE;
+  int rampUpEndSample = juce::jlimit(0.0f, (float)ENV_LUT_SIZE, scaledTilt - scaledShape);
+  int rampDownStartSample = juce::jlimit(0.0f, (float)ENV_LUT_SIZE, scaledTilt + scaledShape);
+  return rampUpEndSample * (ENV_LUT_SIZE + 1) + rampDownStartSample;
+}
+
+const float* GrainEnvelopeTables::find(int key) {
+  jassert(key >= 0 && key < NUM_KEYS);
+  return getGrainEnvelopeStorage().tables[key].load(std::memory_order_acquire);
+}
+
+const float* GrainEnvelopeTables::getOrCreate(int key) {
+  if (const float* table = find(key)) return table;
+
+  const int rampUpEndSample = key / (ENV_LUT_SIZE + 1);
+  const int rampDownStartSample = key % (ENV_LUT_SIZE + 1);
+  float* lut = new float[ENV_LUT_SIZE];
+  for (int i = 0; i < ENV_LUT_SIZE; i++) {
+    if (i < rampUpEndSample) {
+      lut[i] = (float)i / rampUpEndSample;
+    } else if (i > rampDownStartSample) {
+      lut[i] = 1.0f - (float)(i - rampDownStartSample) / (ENV_LUT_SIZE - rampDownStartSample);
+    } else {
+      lut[i] = 1.0f;
+    }
+  }
+  juce::FloatVectorOperations::clip(lut, lut, 0.0f, 1.0f, ENV_LUT_SIZE);
+
+  // Another thread could have built the same table in the meantime, only one gets published
+  float* expected = nullptr;
+  if (!getGrainEnvelopeStorage().tables[key].compare_exchange_strong(expected, lut, std::memory_order_acq_rel)) {
+    delete[] lut;
+    return expected;
+  }
+  return lut;
+}
+
 void ParamGlobal::addParams(juce::AudioProcessor& p) {
   p.addParameter(common[GAIN] = new juce::AudioParameterFloat(ParamIDs::globalGain, "Master Gain", ParamRanges::GAIN,
                                                               ParamDefaults::GAIN_DEFAULT));
@@ -57,6 +120,16 @@ void ParamGlobal::addParams(juce::AudioProcessor& p) {
   p.addParameter(common[POS_SPRAY] =
                      new juce::AudioParameterFloat(ParamIDs::globalPositionSpray, "Master Position Spray",
                                                    ParamRanges::POSITION_SPRAY, ParamDefaults::POSITION_SPRAY_DEFAULT));
+  p.addParameter(common[PAN_ADJUST] = new juce::AudioParameterFloat(ParamIDs::globalPanAdjust, "Master Pan Adjust",
+                                                                    ParamRanges::PAN_ADJUST, ParamDefaults::PAN_ADJUST_DEFAULT));
+  p.addParameter(common[PAN_SPRAY] = new juce::AudioParameterFloat(ParamIDs::globalPanSpray, "Master Pan Spray",
+                                                                   ParamRanges::PAN_SPRAY, ParamDefaults::PAN_SPRAY_DEFAULT));
+
+  p.addParameter(polyphony = new juce::AudioParameterInt(ParamIDs::globalPolyphony, "Polyphony", 1, MAX_POLYPHONY, MAX_POLYPHONY));
+  p.addParameter(voiceSteal = new juce::AudioParameterChoice(ParamIDs::globalVoiceSteal, "Voice Steal", VOICE_STEAL_NAMES,
+                                                             ParamGlobal::VoiceSteal::OLDEST));
+  p.addParameter(interpolation = new juce::AudioParameterChoice(ParamIDs::globalInterpolation, "Interpolation",
+                                                                INTERPOLATION_NAMES, Utils::InterpolationType::LINEAR));
 }
 
 void ParamGenerator::addParams(juce::AudioProcessor& p) {
@@ -101,6 +174,12 @@ void ParamGenerator::addParams(juce::AudioProcessor& p) {
   juce::String posSprayId = PITCH_CLASS_NAMES[noteIdx] + ParamIDs::genPositionSpray + juce::String(genIdx);
   p.addParameter(common[POS_SPRAY] = new juce::AudioParameterFloat(posSprayId, posSprayId, ParamRanges::POSITION_SPRAY,
                                                                    ParamDefaults::POSITION_SPRAY_DEFAULT));
+  juce::String panAdjustId = PITCH_CLASS_NAMES[noteIdx] + ParamIDs::genPanAdjust + juce::String(genIdx);
+  p.addParameter(common[PAN_ADJUST] = new juce::AudioParameterFloat(panAdjustId, panAdjustId, ParamRanges::PAN_ADJUST,
+                                                                    ParamDefaults::PAN_ADJUST_DEFAULT));
+  juce::String panSprayId = PITCH_CLASS_NAMES[noteIdx] + ParamIDs::genPanSpray + juce::String(genIdx);
+  p.addParameter(common[PAN_SPRAY] = new juce::AudioParameterFloat(panSprayId, panSprayId, ParamRanges::PAN_SPRAY,
+                                                                   ParamDefaults::PAN_SPRAY_DEFAULT));
 
   // Shape and Tilt have listeners as changing then will change the envolope LUT
   juce::String shapeId = PITCH_CLASS_NAMES[noteIdx] + ParamIDs::genGrainShape + juce::String(genIdx);
@@ -179,6 +258,12 @@ void ParamNote::addParams(juce::AudioProcessor& p) {
   p.addParameter(common[POS_SPRAY] = new juce::AudioParameterFloat(
                      notePrefix + ParamIDs::notePositionSpray, notePrefix + ParamIDs::notePositionSpray,
                      ParamRanges::POSITION_SPRAY, ParamDefaults::POSITION_SPRAY_DEFAULT));
+  p.addParameter(common[PAN_ADJUST] = new juce::AudioParameterFloat(
+                     notePrefix + ParamIDs::notePanAdjust, notePrefix + ParamIDs::notePanAdjust, ParamRanges::PAN_ADJUST,
+                     ParamDefaults::PAN_ADJUST_DEFAULT));
+  p.addParameter(common[PAN_SPRAY] = new juce::AudioParameterFloat(
+                     notePrefix + ParamIDs::notePanSpray, notePrefix + ParamIDs::notePanSpray, ParamRanges::PAN_SPRAY,
+                     ParamDefaults::PAN_SPRAY_DEFAULT));
 
   // Then make each of its generators
   for (auto& generator : generators) {
@@ -211,3 +296,64 @@ void ParamsNote::addParams(juce::AudioProcessor& p) {
     note->addParams(p);
   }
 }
+
+static float getCommonValue(ParamCommon& common, ParamCommon::Type type) {
+  switch (type) {
+    case ParamCommon::Type::FILT_TYPE:
+      return static_cast<juce::AudioParameterChoice*>(common.common[type])->getIndex();
+    case ParamCommon::Type::GRAIN_SYNC:
+      return static_cast<juce::AudioParameterBool*>(common.common[type])->get() ? 1.0f : 0.0f;
+    default:
+      return static_cast<juce::AudioParameterFloat*>(common.common[type])->get();
+  }
+}
+
+float Parameters::resolveParam(ParamGenerator& pGen, ParamNote& pNote, ParamCommon::Type type) {
+  const float defaultVal = COMMON_DEFAULTS[type];
+  const float genValue = getCommonValue(pGen, type);
+  if (genValue != defaultVal) return genValue;
+  const float noteValue = getCommonValue(pNote, type);
+  if (noteValue != defaultVal) return noteValue;
+  return getCommonValue(global, type);
+}
+
+Parameters::Parameters() {
+  global.anyEnvPending = &mAnyEnvPending;
+  for (auto& pNote : note.notes) {
+    pNote->anyEnvPending = &mAnyEnvPending;
+    for (auto& pGen : pNote->generators) {
+      pGen->anyEnvPending = &mAnyEnvPending;
+    }
+  }
+  // Always running, the audio thread can't start a timer or post a message
+  startTimerHz(ENV_UPDATE_HZ);
+}
+
+void Parameters::timerCallback() {
+  if (!mAnyEnvPending.exchange(false)) return;
+  global.updatePendingGrainEnvelope();
+  for (auto& pNote : note.notes) {
+    pNote->updatePendingGrainEnvelope();
+    for (auto& pGen : pNote->generators) {
+      pGen->updatePendingGrainEnvelope();
+    }
+  }
+}
+
+void Parameters::updateSnapshot() {
+  // Clear first so a change made while building marks the snapshot dirty again
+  snapshotDirty.store(false);
+  for (auto& pNote : note.notes) {
+    for (auto& pGen : pNote->generators) {
+      ParamSnapshot::Generator& genSnapshot = snapshot.generators[pNote->noteIdx][pGen->genIdx];
+      for (int type = 0; type < ParamCommon::Type::NUM_COMMON; ++type) {
+        genSnapshot.common[type] = resolveParam(*pGen, *pNote, static_cast<ParamCommon::Type>(type));
+      }
+      genSnapshot.shouldPlay = pNote->shouldPlayGenerator(pGen->genIdx);
+      genSnapshot.candidateIdx = pGen->candidate->get();
+    }
+  }
+  snapshot.polyphony = global.polyphony->get();
+  snapshot.voiceSteal = global.voiceSteal->getIndex();
+  snapshot.interpolation = static_cast<Utils::InterpolationType>(global.interpolation->getIndex());
+}
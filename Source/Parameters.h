@@ -11,6 +11,7 @@
 #pragma once
 
 #include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
 #include <juce_dsp/juce_dsp.h>
 
 #include "Utils.h"
@@ -42,6 +43,8 @@ static juce::String notePitchAdjust{"_note_pitch_adjust"};
 static juce::String notePitchSpray{"_note_pitch_spray"};
 static juce::String notePositionAdjust{"_note_position_adjust"};
 static juce::String notePositionSpray{"_note_position_spray"};
+static juce::String notePanAdjust{"_note_pan_adjust"};
+static juce::String notePanSpray{"_note_pan_spray"};
 // Generator params
 static juce::String genEnable{"_enable_gen_"};
 static juce::String genCandidate{"_candidate_gen_"};
@@ -62,6 +65,8 @@ static juce::String genPitchAdjust{"_pitch_adjust_gen_"};
 static juce::String genPitchSpray{"_pitch_spray_gen_"};
 static juce::String genPositionAdjust{"_position_adjust_gen_"};
 static juce::String genPositionSpray{"_position_spray_gen_"};
+static juce::String genPanAdjust{"_pan_adjust_gen_"};
+static juce::String genPanSpray{"_pan_spray_gen_"};
 // Global params
 static juce::String globalGain{"global_gain"};
 static juce::String globalAttack{"global_attack"};
@@ -80,6 +85,11 @@ static juce::String globalPitchAdjust{"global_pitch_adjust"};
 static juce::String globalPitchSpray{"global_pitch_spray"};
 static juce::String globalPositionAdjust{"global_position_adjust"};
 static juce::String globalPositionSpray{"global_position_spray"};
+static juce::String globalPanAdjust{"global_pan_adjust"};
+static juce::String globalPanSpray{"global_pan_spray"};
+static juce::String globalPolyphony{"global_polyphony"};
+static juce::String globalVoiceSteal{"global_voice_steal"};
+static juce::String globalInterpolation{"global_interpolation"};
 }  // namespace ParamIDs
 
 namespace ParamRanges {
@@ -98,6 +108,8 @@ static juce::NormalisableRange<float> PITCH_ADJUST(-0.25f, 0.25f);
 static juce::NormalisableRange<float> PITCH_SPRAY(0.0f, 0.1f);
 static juce::NormalisableRange<float> POSITION_ADJUST(-0.5f, 0.5f);
 static juce::NormalisableRange<float> POSITION_SPRAY(0.0f, 0.3f);
+static juce::NormalisableRange<float> PAN_ADJUST(-1.0f, 1.0f);
+static juce::NormalisableRange<float> PAN_SPRAY(0.0f, 1.0f);
 
 static int SYNC_DIV_MAX = 4;  // pow of 2 division, so 1/16
 }  // namespace ParamRanges
@@ -121,11 +133,15 @@ static float PITCH_ADJUST_DEFAULT = 0.0f;
 static float PITCH_SPRAY_DEFAULT = 0.01f;
 static float POSITION_ADJUST_DEFAULT = 0.0f;
 static float POSITION_SPRAY_DEFAULT = 0.0f;
+static float PAN_ADJUST_DEFAULT = 0.0f;
+static float PAN_SPRAY_DEFAULT = 0.0f;
 }  // namespace ParamDefaults
 
 enum ParamType { GLOBAL, NOTE, GENERATOR };
 static juce::Array<juce::String> PITCH_CLASS_NAMES{"C", "Cs", "D", "Ds", "E", "F", "Fs", "G", "Gs", "A", "As", "B"};
 static juce::Array<juce::String> FILTER_TYPE_NAMES{"none", "lowpass", "highpass", "bandpass"};
+static juce::Array<juce::String> VOICE_STEAL_NAMES{"oldest", "quietest"};
+static juce::Array<juce::String> INTERPOLATION_NAMES{"linear", "hermite", "sinc"};
 
 struct ParamHelper {
   static juce::String getParamID(juce::AudioProcessorParameter* param) {
@@ -146,6 +162,22 @@ static constexpr auto NUM_GENERATORS = 4;
 static constexpr auto SOLO_NONE = -1;
 static constexpr auto NUM_FILTER_TYPES = 3;
 static constexpr auto ENV_LUT_SIZE = 128;  // grain env lookup table size
+static constexpr auto MAX_POLYPHONY = 16;  // number of preallocated voices in the synth
+
+/**
+ * Registry of grain envelope tables (ENV_LUT_SIZE long) shared by every generator. A table only depends on where its ramps end and
+ * start, so that pair is the key. Tables are built the first time a key is asked for and are never modified or freed after being
+ * published, so the audio thread can hold raw pointers to them.
+ */
+struct GrainEnvelopeTables {
+  static int getKey(float shape, float tilt);
+  // Lock and allocation free, returns nullptr if the table was never built
+  static const float* find(int key);
+  // Allocates the table if needed, don't call from the audio thread
+  static const float* getOrCreate(int key);
+
+  static constexpr int NUM_KEYS = (ENV_LUT_SIZE + 1) * (ENV_LUT_SIZE + 1);
+};
 
 // Common parameters types used by each generator, note and globally
 class ParamCommon : public juce::AudioProcessorParameter::Listener {
@@ -153,7 +185,8 @@ class ParamCommon : public juce::AudioProcessorParameter::Listener {
   ParamCommon(ParamType type) : type(type) {
     filter.setType(juce::dsp::StateVariableTPTFilterType::lowpass);
     filter.setCutoffFrequency(ParamDefaults::FILTER_LP_CUTOFF_DEFAULT_HZ);
-    updateGrainEnvelopeLUT(grainEnvLUT, ParamDefaults::GRAIN_SHAPE_DEFAULT, ParamDefaults::GRAIN_TILT_DEFAULT);
+    grainEnv.store(GrainEnvelopeTables::getOrCreate(
+        GrainEnvelopeTables::getKey(ParamDefaults::GRAIN_SHAPE_DEFAULT, ParamDefaults::GRAIN_TILT_DEFAULT)));
   }
   ~ParamCommon() {
     common[GRAIN_SHAPE]->removeListener(this);
@@ -181,6 +214,8 @@ class ParamCommon : public juce::AudioProcessorParameter::Listener {
     PITCH_SPRAY,
     POS_ADJUST,
     POS_SPRAY,
+    PAN_ADJUST,
+    PAN_SPRAY,
     NUM_COMMON
   };
 
@@ -202,6 +237,8 @@ class ParamCommon : public juce::AudioProcessorParameter::Listener {
     common[PITCH_SPRAY]->addListener(listener);
     common[POS_ADJUST]->addListener(listener);
     common[POS_SPRAY]->addListener(listener);
+    common[PAN_ADJUST]->addListener(listener);
+    common[PAN_SPRAY]->addListener(listener);
   }
   void removeListener(juce::AudioProcessorParameter::Listener* listener) {
     common[GAIN]->removeListener(listener);
@@ -221,6 +258,8 @@ class ParamCommon : public juce::AudioProcessorParameter::Listener {
     common[PITCH_SPRAY]->removeListener(listener);
     common[POS_ADJUST]->removeListener(listener);
     common[POS_SPRAY]->removeListener(listener);
+    common[PAN_ADJUST]->removeListener(listener);
+    common[PAN_SPRAY]->removeListener(listener);
   }
 
   void resetParams(bool fullClear = true) {
@@ -236,6 +275,8 @@ class ParamCommon : public juce::AudioProcessorParameter::Listener {
     ParamHelper::setParam(P_FLOAT(common[PITCH_SPRAY]), 0.0f);
     ParamHelper::setParam(P_FLOAT(common[POS_ADJUST]), 0.0f);
     ParamHelper::setParam(P_FLOAT(common[POS_SPRAY]), ParamDefaults::POSITION_SPRAY_DEFAULT);
+    ParamHelper::setParam(P_FLOAT(common[PAN_ADJUST]), ParamDefaults::PAN_ADJUST_DEFAULT);
+    ParamHelper::setParam(P_FLOAT(common[PAN_SPRAY]), ParamDefaults::PAN_SPRAY_DEFAULT);
     ParamHelper::setParam(P_FLOAT(common[GRAIN_SHAPE]), 0.5f);
     ParamHelper::setParam(P_FLOAT(common[GRAIN_TILT]), 0.5f);
     ParamHelper::setParam(P_FLOAT(common[GRAIN_RATE]), ParamDefaults::GRAIN_RATE_DEFAULT);
@@ -245,7 +286,7 @@ class ParamCommon : public juce::AudioProcessorParameter::Listener {
 
   void parameterValueChanged(int paramIdx, float newValue) override {
     if (paramIdx == common[GRAIN_SHAPE]->getParameterIndex() || paramIdx == common[GRAIN_TILT]->getParameterIndex()) {
-      updateGrainEnvelopeLUT(grainEnvLUT, P_FLOAT(common[GRAIN_SHAPE])->get(), P_FLOAT(common[GRAIN_TILT])->get());
+      updateGrainEnvelope(P_FLOAT(common[GRAIN_SHAPE])->get(), P_FLOAT(common[GRAIN_TILT])->get());
     } else if (paramIdx == common[FILT_TYPE]->getParameterIndex()) {
       switch (P_CHOICE(common[FILT_TYPE])->getIndex()) {
         case Utils::FilterType::LOWPASS: {
@@ -275,38 +316,42 @@ class ParamCommon : public juce::AudioProcessorParameter::Listener {
 
   // Type of derived class
   ParamType type;
-  // LUT of the grain envelope
-  std::vector<float> grainEnvLUT;
+  // Grain envelope table (ENV_LUT_SIZE long) from GrainEnvelopeTables, swapped when shape or tilt change
+  std::atomic<const float*> grainEnv{nullptr};
   // State variable filter for generator
   juce::dsp::StateVariableTPTFilter<float> filter;
   double sampleRate = 48000;
+  // Raised along with this one's own flag when a table is left for the message thread to build, shared by all the params of
+  // a Parameters which polls it
+  std::atomic<bool>* anyEnvPending = nullptr;
+
+  // Builds and publishes the table a change off the message thread left pending, message thread only
+  void updatePendingGrainEnvelope() {
+    if (mIsEnvPending.exchange(false)) {
+      grainEnv.store(GrainEnvelopeTables::getOrCreate(mPendingEnvKey.load()));
+    }
+  }
 
  private:
-  void updateGrainEnvelopeLUT(std::vector<float>& lut, float shape, float tilt) {
-    lut.clear();
-    /* LUT divided into 3 parts
-
-                 1.0
-                -----
-       rampUp  /     \  rampDown
-              /       \
-    */
-    float scaledShape = (shape * ENV_LUT_SIZE) / 2.0f;
-    float scaledTilt = tilt * ENV_LUT_SIZE;
-    int rampUpEndSample = juce::jmax(0.0f, scaledTilt - scaledShape);
-    int rampDownStartSample = juce::jmin((float)ENV_LUT_SIZE, scaledTilt + scaledShape);
-    for (int i = 0; i < ENV_LUT_SIZE; i++) {
-      if (i < rampUpEndSample) {
-        lut.push_back((float)i / rampUpEndSample);
-      } else if (i > rampDownStartSample) {
-        lut.push_back(1.0f - (float)(i - rampDownStartSample) / (ENV_LUT_SIZE - rampDownStartSample));
-      } else {
-        lut.push_back(1.0f);
-      }
+  void updateGrainEnvelope(float shape, float tilt) {
+    const int key = GrainEnvelopeTables::getKey(shape, tilt);
+    // Always set so a pending async update can't publish an older table after this one
+    mPendingEnvKey.store(key);
+    if (const float* table = GrainEnvelopeTables::find(key)) {
+      grainEnv.store(table);
+    } else if (juce::MessageManager::existsAndIsCurrentThread()) {
+      grainEnv.store(GrainEnvelopeTables::getOrCreate(key));
+    } else {
+      // Could be the audio thread (host automation), which can't allocate the new table or post a message, it is built when
+      // Parameters next polls
+      mIsEnvPending.store(true);
+      if (anyEnvPending != nullptr) anyEnvPending->store(true);
     }
-    juce::FloatVectorOperations::clip(lut.data(), lut.data(), 0.0f, 1.0f, lut.size());
   }
 
+  std::atomic<int> mPendingEnvKey{0};
+  std::atomic<bool> mIsEnvPending{false};
+
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParamCommon)
 };
 
@@ -326,7 +371,9 @@ static float COMMON_DEFAULTS[ParamCommon::Type::NUM_COMMON] = {ParamDefaults::GA
                                                                ParamDefaults::PITCH_ADJUST_DEFAULT,
                                                                ParamDefaults::PITCH_SPRAY_DEFAULT,
                                                                ParamDefaults::POSITION_ADJUST_DEFAULT,
-                                                               ParamDefaults::POSITION_SPRAY_DEFAULT};
+                                                               ParamDefaults::POSITION_SPRAY_DEFAULT,
+                                                               ParamDefaults::PAN_ADJUST_DEFAULT,
+                                                               ParamDefaults::PAN_SPRAY_DEFAULT};
 
 struct ParamCandidate {
   float posRatio;
@@ -457,14 +504,6 @@ struct ParamsNote {
     }
   }
 
-  // always send creation and have callback scope decide if valid or not
-  void grainCreated(Utils::PitchClass pitchClass, int genIdx, float durationSec, float envGain) {
-    if (onGrainCreated != nullptr) {
-      onGrainCreated(pitchClass, genIdx, durationSec, envGain);
-    }
-  }
-  std::function<void(Utils::PitchClass pitchClass, int genIdx, float durationSec, float envGain)> onGrainCreated = nullptr;
-
   std::array<std::unique_ptr<ParamNote>, Utils::PitchClass::COUNT> notes;
 
   juce::XmlElement* getXml() {
@@ -490,11 +529,34 @@ struct ParamGlobal : ParamCommon {
   ParamGlobal() : ParamCommon(ParamType::GLOBAL) {}
   ~ParamGlobal() {}
 
+  // Which voice gets cut when a new note comes in and all voices are in use
+  enum VoiceSteal { OLDEST, QUIETEST };
+
   void addParams(juce::AudioProcessor& p);
 
+  juce::AudioParameterInt* polyphony;
+  juce::AudioParameterChoice* voiceSteal;
+  juce::AudioParameterChoice* interpolation;  // Quality (and cost) of reading grains from the source
+
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParamGlobal)
 };
 
+/**
+ * Flat copy of the resolved (global -> note -> generator) values each generator plays with. The audio thread only reads from this
+ * so it never has to walk the parameter hierarchy or dynamic_cast. Rebuilt by Parameters::updateSnapshot() after a change.
+ */
+struct ParamSnapshot {
+  struct Generator {
+    std::array<float, ParamCommon::Type::NUM_COMMON> common;  // bool/choice params are stored as 0/1 and the choice index
+    bool shouldPlay;
+    int candidateIdx;
+  };
+  std::array<std::array<Generator, NUM_GENERATORS>, Utils::PitchClass::COUNT> generators;
+  int polyphony = MAX_POLYPHONY;
+  int voiceSteal = ParamGlobal::VoiceSteal::OLDEST;
+  Utils::InterpolationType interpolation = Utils::InterpolationType::LINEAR;
+};
+
 /**
  * A representation of the last UI settings to restore it when loading the
  * editor. The Synth owns this and used to allow state to be saved properly as
@@ -559,12 +621,32 @@ struct ParamUI {
   int trimPlaybackMaxSample;
 };
 
-struct Parameters {
+struct Parameters : juce::AudioProcessorParameter::Listener, juce::Timer {
+  Parameters();
+  ~Parameters() override { stopTimer(); }
+
   // The 3 types of parameter sets
   ParamUI ui;
   ParamGlobal global;
   ParamsNote note;
 
+  // Resolved values for the audio thread, only rebuilt when a parameter has changed since the last build
+  ParamSnapshot snapshot;
+  std::atomic<bool> snapshotDirty{true};
+  void updateSnapshot();
+
+  // Listens to every parameter of the processor to know when the snapshot is out of date
+  void listenToAllParams(juce::AudioProcessor& p) {
+    for (juce::AudioProcessorParameter* param : p.getParameters()) {
+      param->addListener(this);
+    }
+  }
+  void parameterValueChanged(int, float) override { snapshotDirty.store(true); }
+  void parameterGestureChanged(int, bool) override {}
+
+  // Builds the grain envelopes a shape or tilt change on another thread left pending, one timer for every ParamCommon
+  void timerCallback() override;
+
   // Called when current selected note or generator changes
   // Should be used only by PluginEditor and passed on to subcomponents
   std::function<void()> onSelectedChange = nullptr;
@@ -658,4 +740,11 @@ struct Parameters {
     // Both note and generator are still defaults, so let's use the global value
     return P_BOOL(global.common[type])->get();
   }
+
+ private:
+  static constexpr auto ENV_UPDATE_HZ = 30;
+  std::atomic<bool> mAnyEnvPending{false};  // Set by any ParamCommon with a pending envelope
+
+  // Same hierarchy lookup as the getters above, but the parameter class is known from the type so there is no need to dynamic_cast
+  float resolveParam(ParamGenerator& pGen, ParamNote& pNote, ParamCommon::Type type);
 };
\ No newline at end of file
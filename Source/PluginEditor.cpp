@@ -34,13 +34,13 @@ GRainbowAudioProcessorEditor::GRainbowAudioProcessorEditor(GranularSynth& synth)
     : AudioProcessorEditor(&synth),
       mSynth(synth),
       mParameters(synth.getParams()),
-      mArcSpec(synth.getParamsNote(), synth.getParamUI()),
+      mArcSpec(synth.getParamsNote(), synth.getParamUI(), synth.getGrainEvents()),
       mKeyboard(synth.getKeyboardState(), synth.getParams()),
       mEnvAdsr(synth.getParams()),
       mEnvGrain(synth.getParams()),
       mGrainControl(synth.getParams()),
       mFilterControl(synth.getParams()),
-      mProgressBar(synth.getLoadingProgress()),
+      mProgressBar(mLoadingProgress),
       mTrimSelection(mFormatManager, synth.getParamUI()) {
   setLookAndFeel(&mRainbowLookAndFeel);
   mErrorMessage.clear();
@@ -90,10 +90,12 @@ GRainbowAudioProcessorEditor::GRainbowAudioProcessorEditor(GranularSynth& synth)
 
   mResourceUsage.setColour(juce::Label::ColourIds::textColourId, juce::Colours::black);
   addAndMakeVisible(mResourceUsage);
+  mBlockStats.setColour(juce::Label::ColourIds::textColourId, juce::Colours::black);
+  addAndMakeVisible(mBlockStats);
 
   // Arc spectrogram
+  // Views can be picked as soon as their own image is done, saving a preset needs all of them
   mArcSpec.onImagesComplete = [this]() {
-    const juce::MessageManagerLock lock;
     jassert(mParameters.ui.specComplete);
     mArcSpec.setSpecType(ParamUI::SpecType::WAVEFORM);
     mBtnPreset.setEnabled(true);
@@ -115,9 +117,9 @@ GRainbowAudioProcessorEditor::GRainbowAudioProcessorEditor(GranularSynth& synth)
     if (start == end) {
       displayError("Attempted to select an empty range");
     } else {
-      mSynth.processInput(juce::Range<juce::int64>(start, end), false);
-      // Reset any UI elements that will need to wait until processing
+      // Reset any UI elements that will need to wait until processing, before the synth replaces the buffers they draw
       mArcSpec.reset();
+      mSynth.processInput(juce::Range<juce::int64>(start, end), false);
       mBtnPreset.setEnabled(false);
       updateCenterComponent(ParamUI::CenterComponent::ARC_SPEC);
       mArcSpec.loadWaveformBuffer(&mSynth.getAudioBuffer());
@@ -201,8 +203,8 @@ void GRainbowAudioProcessorEditor::updateCenterComponent(ParamUI::CenterComponen
 void GRainbowAudioProcessorEditor::timerCallback() {
   // Update progress bar when loading audio clip
   // Will overlay on the other center components
-  double loadingProgress = mSynth.getLoadingProgress();
-  if (loadingProgress < 1.0 && loadingProgress > 0.0) {
+  mLoadingProgress = mSynth.getLoadingProgress();
+  if (mLoadingProgress < 1.0 && mLoadingProgress > 0.0) {
     mProgressBar.setVisible(true);
   } else {
     mProgressBar.setVisible(false);
@@ -257,7 +259,31 @@ void GRainbowAudioProcessorEditor::timerCallback() {
                            juce::dontSendNotification);
   }
 
-  repaint();
+  // Always drain, even if nothing is shown, so the stats are fresh when turned on
+  mSynth.getBlockStats().drain(mBlockStatsSummary);
+  const juce::uint32 nowMs = juce::Time::getMillisecondCounter();
+  if (nowMs - mBlockStatsReportMs >= BLOCK_STATS_REPORT_MS) {
+    if (PowerUserSettings::get().getResourceUsage() && mBlockStatsSummary.numBlocks > 0) {
+      const BlockStats::Summary& stats = mBlockStatsSummary;
+      const double worstLoad = stats.worstBudgetMs > 0.0 ? (stats.worstBlockMs / stats.worstBudgetMs) * 100.0 : 0.0;
+      mBlockStats.setText("Block " + juce::String(stats.avgBlockMs, 2) + " ms | Worst " + juce::String(worstLoad, 0) +
+                              "% | Grains " + juce::String(stats.activeGrains) + " | Dropped " + juce::String(stats.grainsDropped),
+                          juce::dontSendNotification);
+    }
+    if (PowerUserSettings::get().getLogBlockStats()) {
+      juce::Logger::writeToLog("gRainbow audio thread: " + mBlockStatsSummary.toString());
+    }
+    mBlockStatsSummary = BlockStats::Summary();
+    mBlockStatsReportMs = nowMs;
+  }
+
+  // Only the keyboard, note display and the arrows drawn over the arc change every frame, everything else (including the arc's
+  // grains) repaints itself when it changes
+  const float arrowLength = (mArcSpec.getHeight() / 4.5f) + NOTE_BULB_SIZE;
+  const juce::Rectangle<float> arrowBounds(mNoteDisplayRect.getCentreX() - arrowLength, mNoteDisplayRect.getY() - arrowLength,
+                                           arrowLength * 2.0f, arrowLength);
+  repaint(mNoteDisplayRect.getUnion(arrowBounds).expanded(NOTE_BULB_SIZE).getSmallestIntegerContainer());
+  mKeyboard.repaint();
 }
 
 //==============================================================================
@@ -302,7 +328,8 @@ void GRainbowAudioProcessorEditor::paintOverChildren(juce::Graphics& g) {
         // TODO: fix this coloring below
         g.setColour(pitchColour);
         //g.setColour((i == mGeneratorsBox.getSelectedGenerator()) ? pitchColour.brighter() : pitchColour.darker().darker());
-        auto middlePos = candidates[i]->posRatio + (candidates[i]->duration / 2.0f);
+        auto middlePos = mArcSpec.getArcRatio(candidates[i]->posRatio + (candidates[i]->duration / 2.0f));
+        if (middlePos < 0.0f || middlePos > 1.0f) continue;  // Zoomed out of view
         float angleRad = (juce::MathConstants<float>::pi * middlePos) - (juce::MathConstants<float>::pi / 2.0f);
         juce::Point<float> startPoint = juce::Point<float>(mNoteDisplayRect.getCentreX(), mNoteDisplayRect.getY());
         juce::Point<float> endPoint = startPoint.getPointOnCircumference(mArcSpec.getHeight() / 4.5f, angleRad);
@@ -358,6 +385,7 @@ void GRainbowAudioProcessorEditor::resized() {
 
   auto rightPanel = r.removeFromRight(PANEL_WIDTH);
   mResourceUsage.setBounds(rightPanel.removeFromBottom(12));
+  mBlockStats.setBounds(rightPanel.removeFromBottom(12));
   mEnvAdsr.setBounds(rightPanel.removeFromTop(rightPanel.getHeight() / 2.0f));
   mFilterControl.setBounds(rightPanel);  
 
@@ -523,65 +551,19 @@ void GRainbowAudioProcessorEditor::processFile(juce::File file) {
 }
 
 void GRainbowAudioProcessorEditor::processPreset(juce::File file) {
-  Preset::Header header;
-  juce::FileInputStream input(file);
-  if (input.openedOk()) {
-    input.read(&header, sizeof(header));
-
-    if (header.magic != Preset::MAGIC) {
-      displayError("The file is not recognized as a valid .gbow preset file.");
-      return;
-    }
-
-    juce::AudioBuffer<float> fileAudioBuffer;
-    double sampleRate;
-
-    // Currently there is only a VERSION_MAJOR of 0
-    if (header.versionMajor == 0) {
-      // Get Audio Buffer blob
-      fileAudioBuffer.setSize(header.audioBufferChannel, header.audioBufferNumberOfSamples);
-      input.read(fileAudioBuffer.getWritePointer(0), header.audioBufferSize);
-      sampleRate = header.audioBufferSamplerRate;
-
-      // Get offsets and load all png for spec images
-      uint32_t maxSpecImageSize =
-          juce::jmax(header.specImageSpectrogramSize, header.specImageHpcpSize, header.specImageDetectedSize);
-      void* specImageData = malloc(maxSpecImageSize);
-      jassert(specImageData != nullptr);
-      input.read(specImageData, header.specImageSpectrogramSize);
-      mParameters.ui.specImages[ParamUI::SpecType::SPECTROGRAM] =
-          juce::PNGImageFormat::loadFrom(specImageData, header.specImageSpectrogramSize);
-      input.read(specImageData, header.specImageHpcpSize);
-      mParameters.ui.specImages[ParamUI::SpecType::HPCP] = juce::PNGImageFormat::loadFrom(specImageData, header.specImageHpcpSize);
-      input.read(specImageData, header.specImageDetectedSize);
-      mParameters.ui.specImages[ParamUI::SpecType::DETECTED] =
-          juce::PNGImageFormat::loadFrom(specImageData, header.specImageDetectedSize);
-      free(specImageData);
-
-      // juce::FileInputStream uses 'int' to read
-      int xmlSize = static_cast<int>(input.getTotalLength() - input.getPosition());
-      void* xmlData = malloc(xmlSize);
-      jassert(xmlData != nullptr);
-      input.read(xmlData, xmlSize);
-      mSynth.setPresetParamsXml(xmlData, xmlSize);
-      free(xmlData);
-    } else {
-      displayError(juce::String::formatted(
-          "The file is gbow version %u.%u and is not supported. This copy of gRainbow can open files up to version %u.%u",
-          header.versionMajor, header.versionMinor, Preset::VERSION_MAJOR, Preset::VERSION_MINOR));
-      return;
-    }
-
-    mBtnPreset.setEnabled(true);
-    mArcSpec.loadPreset();
-    mSynth.setInputBuffer(&fileAudioBuffer, sampleRate);
-    mSynth.processInput(juce::Range<juce::int64>(), true);
-    mArcSpec.loadWaveformBuffer(&mSynth.getAudioBuffer());
-    mLabelFileName.setText(mParameters.ui.fileName, juce::dontSendNotification);
-  } else {
-    displayError(juce::String::formatted("The file failed to open because %s", input.getStatus().getErrorMessage().toRawUTF8()));
+  // The preset replaces the buffers being drawn
+  mArcSpec.cancelImages();
+  mSynth.loadPreset(file, mErrorMessage);
+  if (!mErrorMessage.isEmpty()) {
+    displayError(mErrorMessage);
+    mErrorMessage.clear();
     return;
   }
+
+  mBtnPreset.setEnabled(true);
+  mArcSpec.loadPreset();
+  mArcSpec.loadWaveformBuffer(&mSynth.getAudioBuffer());
+  mLabelFileName.setText(mParameters.ui.fileName, juce::dontSendNotification);
 }
 
 void GRainbowAudioProcessorEditor::savePreset() {
@@ -80,6 +80,7 @@ class GRainbowAudioProcessorEditor : public juce::AudioProcessorEditor,
   static constexpr int NOTE_DISPLAY_HEIGHT = 20;
   static constexpr float KEYBOARD_HEIGHT = 0.27f;
   static constexpr auto FILE_RECORDING = "gRainbow_user_recording.wav";
+  static constexpr juce::uint32 BLOCK_STATS_REPORT_MS = 1000;  // How often the audio thread stats are shown/logged
 
   // DSP Modules
   GranularSynth& mSynth;
@@ -99,11 +100,15 @@ class GRainbowAudioProcessorEditor : public juce::AudioProcessorEditor,
   juce::SharedResourcePointer<juce::TooltipWindow> mTooltipWindow;
   SettingsComponent mSettings;
   juce::Label mResourceUsage;
+  juce::Label mBlockStats;
+  BlockStats::Summary mBlockStatsSummary;  // Drained from the synth every callback until it is reported
+  juce::uint32 mBlockStatsReportMs = 0;
 
   // main center UI component
   GRainbowLogo mLogo;
   ArcSpectrogram mArcSpec;
   TrimSelection mTrimSelection;
+  double mLoadingProgress = 0.0;  // Copied from the synth every callback, the progress bar reads it on its own timer
   juce::ProgressBar mProgressBar;
 
   // Synth owns, but need to grab params on reloading of plugin
@@ -13,9 +13,60 @@
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <chrono>
+#include <span>
 
 namespace Utils {
-typedef std::vector<std::vector<float>> SpecBuffer;
+/**
+ * @brief Frames x bins of analysis data (spectrum, HPCP, etc) stored in one contiguous block, indexed as spec[frame][bin].
+ * setSize() keeps the allocation when it is already large enough so analysis can be rerun without allocator traffic.
+ */
+class SpecBuffer {
+ public:
+  SpecBuffer() = default;
+  SpecBuffer(size_t numFrames, size_t numBins) { setSize(numFrames, numBins); }
+
+  // All values are zeroed
+  void setSize(size_t numFrames, size_t numBins) {
+    mNumFrames = numFrames;
+    mNumBins = numBins;
+    mData.assign(numFrames * numBins, 0.0f);
+  }
+  void clear() { setSize(0, 0); }
+  // Keeps every frameStep'th frame of source, e.g. a hop 512 spectrum with a frameStep of 8 is viewed with a hop of 4096
+  void setDecimated(const SpecBuffer& source, size_t frameStep) {
+    setSize((source.size() + frameStep - 1) / frameStep, source.getNumBins());
+    for (size_t frame = 0; frame < mNumFrames; ++frame) {
+      std::span<const float> sourceFrame = source[frame * frameStep];
+      std::copy(sourceFrame.begin(), sourceFrame.end(), (*this)[frame].begin());
+    }
+  }
+  // Copies numFrames frames of source starting at startFrame, clamped to the frames source has
+  void setSlice(const SpecBuffer& source, size_t startFrame, size_t numFrames) {
+    startFrame = std::min(startFrame, source.size());
+    numFrames = std::min(numFrames, source.size() - startFrame);
+    setSize(numFrames, source.getNumBins());
+    std::copy(source[startFrame].data(), source[startFrame].data() + numFrames * mNumBins, mData.begin());
+  }
+  // Frees the memory as well, a full spectrum can be large
+  void release() {
+    clear();
+    mData.shrink_to_fit();
+  }
+
+  size_t size() const { return mNumFrames; }
+  bool empty() const { return mNumFrames == 0; }
+  size_t getNumBins() const { return mNumBins; }
+
+  std::span<float> operator[](size_t frame) { return {mData.data() + frame * mNumBins, mNumBins}; }
+  std::span<const float> operator[](size_t frame) const { return {mData.data() + frame * mNumBins, mNumBins}; }
+  float* data() { return mData.data(); }
+  const float* data() const { return mData.data(); }
+
+ private:
+  size_t mNumFrames = 0;
+  size_t mNumBins = 0;
+  std::vector<float> mData;
+};
 
 // UI spacing and colours
 static constexpr int PADDING = 6;
@@ -43,6 +94,7 @@ static juce::Array<juce::String> PITCH_CLASS_DISP_NAMES{"C", "C#", "D", "D#", "E
 
 enum EnvelopeState { ATTACK, DECAY, SUSTAIN, RELEASE };
 enum FilterType { NO_FILTER, LOWPASS, HIGHPASS, BANDPASS };
+enum InterpolationType { LINEAR, HERMITE, SINC };
 
 static inline PitchClass getPitchClass(int midiNoteNumber) { return (PitchClass)(midiNoteNumber % PitchClass::COUNT); }
 // A "Note" is a wrapper to hold all the information about notes from a MidiMessage we care about sharing around classes
@@ -289,10 +341,11 @@ class BPF {
 
  public:
   BPF() {}
-  BPF(std::vector<float> xPoints, std::vector<float> yPoints) { init(xPoints, yPoints); }
-  void init(std::vector<float> xPoints, std::vector<float> yPoints) {
-    _xPoints = xPoints;
-    _yPoints = yPoints;
+  BPF(const std::vector<float>& xPoints, const std::vector<float>& yPoints) { init(xPoints, yPoints); }
+  // Reuses the storage of the previous init, so rebuilding the same size BPF every frame doesn't allocate
+  void init(const std::vector<float>& xPoints, const std::vector<float>& yPoints) {
+    _xPoints.assign(xPoints.begin(), xPoints.end());
+    _yPoints.assign(yPoints.begin(), yPoints.end());
 
     jassert(_xPoints.size() == _yPoints.size());
     jassert(_xPoints.size() >= 2);
@@ -309,14 +362,13 @@ class BPF {
     }
   }
 
-  inline float operator()(float x) {
+  inline float operator()(float x) const {
     jassert(x >= _xPoints[0]);
     jassert(x <= _xPoints.back());
 
-    std::vector<float>::size_type j = 0;
-    while (x > _xPoints[j + 1]) {
-      j += 1;
-    }
+    // Binary search for the segment x is in, same segment the old linear scan picked for x on a point
+    auto it = std::lower_bound(_xPoints.begin() + 1, _xPoints.end() - 1, x);
+    const size_t j = static_cast<size_t>(it - _xPoints.begin()) - 1;
 
     return (x - _xPoints[j]) * _slopes[j] + _yPoints[j];
   }
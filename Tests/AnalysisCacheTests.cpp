@@ -0,0 +1,190 @@
+/*
+  ==============================================================================
+
+    AnalysisCacheTests.cpp
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "DSP/AnalysisCache.h"
+
+namespace {
+// Random values so the entries don't compress and their sizes are predictable
+Utils::SpecBuffer makeSpec(size_t numFrames, size_t numBins, juce::Random& random) {
+  Utils::SpecBuffer spec(numFrames, numBins);
+  for (size_t i = 0; i < numFrames * numBins; ++i) spec.data()[i] = random.nextFloat();
+  return spec;
+}
+
+PitchDetector::PitchMap makePitches() {
+  PitchDetector::PitchMap pitchMap;
+  for (Utils::PitchClass pitchClass : Utils::ALL_PITCH_CLASS) {
+    std::vector<PitchDetector::Pitch>& pitchVec = pitchMap.getReference(pitchClass);
+    for (int i = 0; i < static_cast<int>(pitchClass) + 1; ++i) {
+      pitchVec.push_back(PitchDetector::Pitch(pitchClass, i / 12.0f, 0.05f, 1.0f - i / 24.0f));
+    }
+  }
+  return pitchMap;
+}
+
+bool isSameSpec(const Utils::SpecBuffer& a, const Utils::SpecBuffer& b) {
+  return a.size() == b.size() && a.getNumBins() == b.getNumBins() &&
+         std::equal(a.data(), a.data() + a.size() * a.getNumBins(), b.data());
+}
+
+juce::File getOnlyEntry(const juce::File& directory) {
+  const juce::Array<juce::File> entries = directory.findChildFiles(juce::File::findFiles, false);
+  REQUIRE(entries.size() == 1);
+  return entries.getFirst();
+}
+
+// Fresh directory for every test, removed when it goes out of scope
+struct TempCacheDirectory {
+  TempCacheDirectory() { REQUIRE(directory.createDirectory()); }
+  ~TempCacheDirectory() { directory.deleteRecursively(); }
+  const juce::File directory = juce::File::createTempFile("gRainbowAnalysisCacheTests");
+};
+}  // namespace
+
+TEST_CASE("AnalysisCache keys", "[analysis cache]") {
+  juce::AudioBuffer<float> audio(2, 1000);
+  audio.clear();
+  audio.setSample(0, 10, 0.5f);
+  const juce::String key = AnalysisCache::getKey(audio, 48000.0, "fft 4096");
+
+  CHECK(AnalysisCache::getKey(audio, 48000.0, "fft 4096") == key);
+  CHECK(AnalysisCache::getKey(audio, 44100.0, "fft 4096") != key);
+  CHECK(AnalysisCache::getKey(audio, 48000.0, "fft 2048") != key);
+  audio.setSample(1, 999, 0.25f);
+  CHECK(AnalysisCache::getKey(audio, 48000.0, "fft 4096") != key);
+}
+
+TEST_CASE("AnalysisCache store and load", "[analysis cache]") {
+  TempCacheDirectory temp;
+  AnalysisCache cache(temp.directory);
+  juce::Random random(1);
+  const Utils::SpecBuffer spectrogram = makeSpec(40, 64, random);
+  const Utils::SpecBuffer hpcp = makeSpec(300, 12, random);
+  PitchDetector::PitchMap pitchMap = makePitches();
+
+  Utils::SpecBuffer loadedSpectrogram, loadedHpcp;
+  PitchDetector::PitchMap loadedPitches;
+  CHECK_FALSE(cache.load("entry", loadedSpectrogram, loadedHpcp, loadedPitches));
+
+  cache.store("entry", spectrogram, hpcp, pitchMap);
+  REQUIRE(cache.load("entry", loadedSpectrogram, loadedHpcp, loadedPitches));
+  CHECK(isSameSpec(loadedSpectrogram, spectrogram));
+  CHECK(isSameSpec(loadedHpcp, hpcp));
+  for (Utils::PitchClass pitchClass : Utils::ALL_PITCH_CLASS) {
+    const std::vector<PitchDetector::Pitch>& expected = pitchMap.getReference(pitchClass);
+    const std::vector<PitchDetector::Pitch>& loaded = loadedPitches.getReference(pitchClass);
+    REQUIRE(loaded.size() == expected.size());
+    for (size_t i = 0; i < loaded.size(); ++i) {
+      CHECK(loaded[i].pitchClass == pitchClass);
+      CHECK(loaded[i].posRatio == expected[i].posRatio);
+      CHECK(loaded[i].duration == expected[i].duration);
+      CHECK(loaded[i].gain == expected[i].gain);
+    }
+  }
+
+  SECTION("other keys still miss") { CHECK_FALSE(cache.load("other", loadedSpectrogram, loadedHpcp, loadedPitches)); }
+
+  SECTION("disabled cache neither loads nor stores") {
+    cache.setEnabled(false);
+    CHECK_FALSE(cache.load("entry", loadedSpectrogram, loadedHpcp, loadedPitches));
+    cache.store("other", spectrogram, hpcp, pitchMap);
+    cache.setEnabled(true);
+    CHECK_FALSE(cache.load("other", loadedSpectrogram, loadedHpcp, loadedPitches));
+  }
+}
+
+TEST_CASE("AnalysisCache rejects damaged entries", "[analysis cache]") {
+  TempCacheDirectory temp;
+  AnalysisCache cache(temp.directory);
+  juce::Random random(2);
+  PitchDetector::PitchMap pitchMap = makePitches();
+  cache.store("entry", makeSpec(40, 64, random), makeSpec(300, 12, random), pitchMap);
+  const juce::File entry = getOnlyEntry(temp.directory);
+
+  juce::MemoryBlock contents;
+  {
+    juce::FileInputStream fileInput(entry);
+    juce::GZIPDecompressorInputStream input(fileInput);
+    input.readIntoMemoryBlock(contents);
+  }
+  auto rewrite = [&entry](const juce::MemoryBlock& newContents) {
+    REQUIRE(entry.deleteFile());
+    juce::FileOutputStream fileOutput(entry);
+    juce::GZIPCompressorOutputStream output(fileOutput);
+    output.write(newContents.getData(), newContents.getSize());
+  };
+
+  Utils::SpecBuffer spectrogram, hpcp;
+  PitchDetector::PitchMap loadedPitches;
+  SECTION("truncated") {
+    for (size_t size : {contents.getSize() - 1, contents.getSize() / 2, static_cast<size_t>(10), static_cast<size_t>(0)}) {
+      rewrite(juce::MemoryBlock(contents.getData(), size));
+      CHECK_FALSE(cache.load("entry", spectrogram, hpcp, loadedPitches));
+    }
+  }
+  SECTION("other version") {
+    juce::MemoryBlock otherVersion(contents);
+    static_cast<uint32_t*>(otherVersion.getData())[1] = AnalysisCache::VERSION + 1;
+    rewrite(otherVersion);
+    CHECK_FALSE(cache.load("entry", spectrogram, hpcp, loadedPitches));
+  }
+  SECTION("not an entry") {
+    juce::MemoryBlock otherMagic(contents);
+    static_cast<uint32_t*>(otherMagic.getData())[0] = ~AnalysisCache::MAGIC;
+    rewrite(otherMagic);
+    CHECK_FALSE(cache.load("entry", spectrogram, hpcp, loadedPitches));
+  }
+  SECTION("not compressed") {
+    REQUIRE(entry.replaceWithData(contents.getData(), contents.getSize()));
+    CHECK_FALSE(cache.load("entry", spectrogram, hpcp, loadedPitches));
+  }
+}
+
+TEST_CASE("AnalysisCache evicts the least recently used entries", "[analysis cache]") {
+  TempCacheDirectory temp;
+  juce::Random random(3);
+  const Utils::SpecBuffer spectrogram = makeSpec(100, 64, random);
+  const Utils::SpecBuffer hpcp = makeSpec(300, 12, random);
+  PitchDetector::PitchMap pitchMap = makePitches();
+
+  // Find out how big an entry is first, every entry below is the same size give or take the compression
+  juce::int64 entrySize = 0;
+  {
+    TempCacheDirectory sizing;
+    AnalysisCache(sizing.directory).store("entry", spectrogram, hpcp, pitchMap);
+    entrySize = getOnlyEntry(sizing.directory).getSize();
+  }
+  AnalysisCache cache(temp.directory, entrySize * 5 / 2);
+
+  // Modification times are what orders the entries, set them apart so file systems with a coarse clock still sort them
+  const juce::Time now = juce::Time::getCurrentTime();
+  auto storeAged = [&](const juce::String& key, int ageSec) {
+    cache.store(key, spectrogram, hpcp, pitchMap);
+    REQUIRE(temp.directory.getChildFile(key + ".gbac").setLastModificationTime(now - juce::RelativeTime::seconds(ageSec)));
+  };
+  storeAged("oldest", 30);
+  storeAged("older", 20);
+
+  Utils::SpecBuffer loadedSpectrogram, loadedHpcp;
+  PitchDetector::PitchMap loadedPitches;
+  SECTION("oldest goes first") {
+    cache.store("newest", spectrogram, hpcp, pitchMap);
+    CHECK_FALSE(cache.load("oldest", loadedSpectrogram, loadedHpcp, loadedPitches));
+    CHECK(cache.load("older", loadedSpectrogram, loadedHpcp, loadedPitches));
+    CHECK(cache.load("newest", loadedSpectrogram, loadedHpcp, loadedPitches));
+  }
+  SECTION("loading counts as a use") {
+    REQUIRE(cache.load("oldest", loadedSpectrogram, loadedHpcp, loadedPitches));
+    CHECK(temp.directory.getChildFile("oldest.gbac").getLastModificationTime() > now - juce::RelativeTime::seconds(20));
+    cache.store("newest", spectrogram, hpcp, pitchMap);
+    CHECK(cache.load("oldest", loadedSpectrogram, loadedHpcp, loadedPitches));
+    CHECK_FALSE(cache.load("older", loadedSpectrogram, loadedHpcp, loadedPitches));
+  }
+}
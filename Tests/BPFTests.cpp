@@ -0,0 +1,58 @@
+/*
+  ==============================================================================
+
+    BPFTests.cpp
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include "Utils.h"
+
+using Catch::Matchers::WithinAbs;
+
+namespace {
+// The linear scan BPF used before the binary search, on a point it picks the segment ending there
+float linearScanBPF(const std::vector<float>& xPoints, const std::vector<float>& yPoints, float x) {
+  size_t j = 0;
+  while (x > xPoints[j + 1]) j++;
+  const float slope = (yPoints[j + 1] - yPoints[j]) / (xPoints[j + 1] - xPoints[j]);
+  return (x - xPoints[j]) * slope + yPoints[j];
+}
+}  // namespace
+
+TEST_CASE("BPF interpolates between its points", "[bpf]") {
+  const Utils::BPF bpf({0.0f, 1.0f, 3.0f}, {0.0f, 2.0f, 1.0f});
+  CHECK_THAT(bpf(0.0f), WithinAbs(0.0, 1e-6));
+  CHECK_THAT(bpf(0.5f), WithinAbs(1.0, 1e-6));
+  CHECK_THAT(bpf(1.0f), WithinAbs(2.0, 1e-6));
+  CHECK_THAT(bpf(2.0f), WithinAbs(1.5, 1e-6));
+  CHECK_THAT(bpf(3.0f), WithinAbs(1.0, 1e-6));
+}
+
+TEST_CASE("BPF binary search matches the linear scan", "[bpf]") {
+  juce::Random random(4);
+  for (int numPoints : {2, 3, 4, 7, 16, 33, 100}) {
+    std::vector<float> xPoints;
+    std::vector<float> yPoints;
+    float x = -1.0f;
+    for (int i = 0; i < numPoints; ++i) {
+      x += 0.1f + random.nextFloat();
+      xPoints.push_back(x);
+      yPoints.push_back(random.nextFloat() * 2.0f - 1.0f);
+    }
+    Utils::BPF bpf;
+    bpf.init(xPoints, yPoints);
+
+    // Every point exactly (where the two segments meet) and random positions in between
+    for (float point : xPoints) {
+      CHECK_THAT(bpf(point), WithinAbs(linearScanBPF(xPoints, yPoints, point), 1e-5));
+    }
+    for (int i = 0; i < 1000; ++i) {
+      const float position = xPoints.front() + random.nextFloat() * (xPoints.back() - xPoints.front());
+      CHECK_THAT(bpf(position), WithinAbs(linearScanBPF(xPoints, yPoints, position), 1e-5));
+    }
+  }
+}
@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    BlockStatsTests.cpp
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include "DSP/BlockStats.h"
+
+using Catch::Matchers::WithinAbs;
+
+namespace {
+BlockStats makeStats(double blockMs, int activeVoices) {
+  BlockStats stats;
+  stats.numSamples = 256;
+  stats.budgetMs = 5.0;
+  stats.blockMs = blockMs;
+  stats.mixMs = 1.0;
+  stats.filterMs = 0.5;
+  stats.spawnMs = 0.25;
+  stats.activeVoices = activeVoices;
+  stats.activeGrains = activeVoices * 10;
+  stats.grainsSpawned = 2;
+  stats.grainsDropped = 1;
+  return stats;
+}
+}  // namespace
+
+TEST_CASE("BlockStats::Summary accumulates blocks", "[block stats]") {
+  BlockStats::Summary summary;
+  CHECK(summary.toString() == "no blocks");
+
+  summary.add(makeStats(1.0, 1));
+  summary.add(makeStats(3.0, 2));
+  summary.add(makeStats(2.0, 3));
+  CHECK(summary.numBlocks == 3);
+  CHECK_THAT(summary.avgBlockMs, WithinAbs(2.0, 1e-9));
+  CHECK(summary.worstBlockMs == 3.0);
+  CHECK(summary.worstBudgetMs == 5.0);
+  CHECK_THAT(summary.mixMs, WithinAbs(3.0, 1e-9));
+  CHECK_THAT(summary.filterMs, WithinAbs(1.5, 1e-9));
+  CHECK_THAT(summary.spawnMs, WithinAbs(0.75, 1e-9));
+  // Counts of what is alive come from the last block, counts of what happened are summed
+  CHECK(summary.activeVoices == 3);
+  CHECK(summary.activeGrains == 30);
+  CHECK(summary.grainsSpawned == 6);
+  CHECK(summary.grainsDropped == 3);
+  CHECK(summary.toString().contains("60% of budget"));
+}
+
+TEST_CASE("BlockStatsFifo hands blocks over in order", "[block stats]") {
+  BlockStatsFifo fifo;
+  BlockStats::Summary summary;
+  CHECK(fifo.drain(summary) == 0);
+
+  // Several times around the buffer, the last block drained is always the last one pushed
+  for (int round = 0; round < 5; ++round) {
+    for (int i = 1; i <= BlockStatsFifo::CAPACITY / 2; ++i) fifo.push(makeStats(1.0, round * 1000 + i));
+    CHECK(fifo.drain(summary) == BlockStatsFifo::CAPACITY / 2);
+    CHECK(summary.activeVoices == round * 1000 + BlockStatsFifo::CAPACITY / 2);
+  }
+  CHECK(summary.numBlocks == 5 * BlockStatsFifo::CAPACITY / 2);
+  CHECK(fifo.getNumDropped() == 0);
+}
+
+TEST_CASE("BlockStatsFifo drops blocks when nobody drains", "[block stats]") {
+  BlockStatsFifo fifo;
+  const int numPushed = BlockStatsFifo::CAPACITY + 10;
+  for (int i = 0; i < numPushed; ++i) fifo.push(makeStats(1.0, i));
+
+  // The oldest blocks are kept, the audio thread never overwrites what the reader hasn't seen
+  BlockStats::Summary summary;
+  const int numDrained = fifo.drain(summary);
+  CHECK(numDrained + fifo.getNumDropped() == numPushed);
+  CHECK(summary.activeVoices == numDrained - 1);
+
+  // Room again once drained
+  fifo.push(makeStats(1.0, -1));
+  CHECK(fifo.drain(summary) == 1);
+  CHECK(summary.activeVoices == -1);
+}
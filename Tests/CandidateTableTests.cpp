@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    CandidateTableTests.cpp
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+
+#include "DSP/CandidateTable.h"
+
+namespace {
+// Every field holds value, so a candidate torn between two writes has fields that disagree
+std::vector<ParamCandidate> makeCandidates(int numCandidates, float value) {
+  return std::vector<ParamCandidate>(numCandidates, ParamCandidate(value, value, value, value));
+}
+}  // namespace
+
+TEST_CASE("CandidateTable set, get and clear", "[candidate table]") {
+  CandidateTable table;
+  ParamCandidate candidate(0.0f, 1.0f, 0.0f, 0.0f);
+  for (Utils::PitchClass pitchClass : Utils::ALL_PITCH_CLASS) {
+    CHECK(table.getNumCandidates(pitchClass) == 0);
+    CHECK_FALSE(table.get(pitchClass, 0, candidate));
+  }
+
+  std::vector<ParamCandidate> candidates;
+  for (int i = 0; i < 3; ++i) candidates.push_back(ParamCandidate(0.1f * i, 1.0f + i, 0.2f * i, 0.3f * i));
+  table.set(Utils::PitchClass::E, candidates);
+  CHECK(table.getNumCandidates(Utils::PitchClass::E) == 3);
+  CHECK(table.getNumCandidates(Utils::PitchClass::F) == 0);
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(table.get(Utils::PitchClass::E, i, candidate));
+    CHECK(candidate.posRatio == candidates[i].posRatio);
+    CHECK(candidate.pbRate == candidates[i].pbRate);
+    CHECK(candidate.duration == candidates[i].duration);
+    CHECK(candidate.salience == candidates[i].salience);
+  }
+  CHECK_FALSE(table.get(Utils::PitchClass::E, -1, candidate));
+  CHECK_FALSE(table.get(Utils::PitchClass::E, 3, candidate));
+
+  SECTION("setting fewer candidates drops the rest") {
+    table.set(Utils::PitchClass::E, makeCandidates(1, 0.5f));
+    CHECK(table.getNumCandidates(Utils::PitchClass::E) == 1);
+    CHECK_FALSE(table.get(Utils::PitchClass::E, 1, candidate));
+  }
+  SECTION("extra candidates are dropped") {
+    table.set(Utils::PitchClass::E, makeCandidates(MAX_CANDIDATES + 4, 0.5f));
+    CHECK(table.getNumCandidates(Utils::PitchClass::E) == MAX_CANDIDATES);
+    CHECK(table.get(Utils::PitchClass::E, MAX_CANDIDATES - 1, candidate));
+    CHECK_FALSE(table.get(Utils::PitchClass::E, MAX_CANDIDATES, candidate));
+  }
+  SECTION("clear") {
+    table.clear();
+    CHECK(table.getNumCandidates(Utils::PitchClass::E) == 0);
+    CHECK_FALSE(table.get(Utils::PitchClass::E, 0, candidate));
+  }
+}
+
+TEST_CASE("CandidateTable reader never sees a torn candidate", "[candidate table]") {
+  static constexpr auto NUM_WRITES = 20000;
+  CandidateTable table;
+  table.set(Utils::PitchClass::A, makeCandidates(MAX_CANDIDATES, 0.0f));
+
+  std::atomic<bool> isWriting{true};
+  std::thread writer([&] {
+    for (int i = 1; i <= NUM_WRITES; ++i) table.set(Utils::PitchClass::A, makeCandidates(MAX_CANDIDATES, (float)i));
+    isWriting = false;
+  });
+
+  int numTorn = 0;
+  int numRead = 0;
+  ParamCandidate candidate(0.0f, 1.0f, 0.0f, 0.0f);
+  while (isWriting) {
+    for (int idx = 0; idx < MAX_CANDIDATES; ++idx) {
+      // A failed read is allowed, it only skips a grain
+      if (!table.get(Utils::PitchClass::A, idx, candidate)) continue;
+      numRead++;
+      if (candidate.pbRate != candidate.posRatio || candidate.duration != candidate.posRatio ||
+          candidate.salience != candidate.posRatio) {
+        numTorn++;
+      }
+    }
+  }
+  writer.join();
+
+  CHECK(numTorn == 0);
+  CHECK(numRead > 0);
+}
+
+TEST_CASE("CandidateTable writers on different threads don't tear candidates", "[candidate table]") {
+  // Like the analysis thread publishing partial candidates while the message thread resets them
+  static constexpr auto NUM_WRITES = 20000;
+  CandidateTable table;
+  auto write = [&table](float sign) {
+    for (int i = 1; i <= NUM_WRITES; ++i) table.set(Utils::PitchClass::A, makeCandidates(MAX_CANDIDATES, sign * i));
+  };
+  std::thread writer1(write, 1.0f);
+  std::thread writer2(write, -1.0f);
+  writer1.join();
+  writer2.join();
+
+  ParamCandidate candidate(0.0f, 1.0f, 0.0f, 0.0f);
+  for (int idx = 0; idx < MAX_CANDIDATES; ++idx) {
+    REQUIRE(table.get(Utils::PitchClass::A, idx, candidate));
+    CHECK(std::abs(candidate.posRatio) == NUM_WRITES);
+    CHECK(candidate.pbRate == candidate.posRatio);
+    CHECK(candidate.duration == candidate.posRatio);
+    CHECK(candidate.salience == candidate.posRatio);
+  }
+}
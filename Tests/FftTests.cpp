@@ -0,0 +1,66 @@
+/*
+  ==============================================================================
+
+    FftTests.cpp
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include "DSP/Fft.h"
+
+using Catch::Matchers::WithinRel;
+
+static constexpr auto WINDOW_SIZE = 1024;
+static constexpr auto HOP_SIZE = 256;
+static constexpr auto NUM_SAMPLES = 48000;
+static constexpr auto THREAD_TIMEOUT_MS = 10000;
+
+TEST_CASE("Fft::onFrameReady", "[fft]") {
+  juce::AudioBuffer<float> audio(1, NUM_SAMPLES);
+  juce::Random random(1);
+  for (int i = 0; i < NUM_SAMPLES; ++i) {
+    audio.setSample(0, i, std::sin(0.05f * i) * (0.5f + 0.5f * random.nextFloat()));
+  }
+  const int numFrames = NUM_SAMPLES / HOP_SIZE + 1;
+  const int numBins = WINDOW_SIZE / 2;
+
+  Fft fft(WINDOW_SIZE, HOP_SIZE, 0.0, 1.0);
+  // Each frame only writes its own slot, so the pool threads never share anything here. Catch assertions aren't thread safe,
+  // they are all made once the thread is done
+  std::vector<std::atomic<int>> numCalls(numFrames);
+  std::atomic<int> numBadFrames{0};
+  Utils::SpecBuffer rawFrames(numFrames, numBins);
+  fft.onFrameReady = [&](int frame, std::span<const float> magnitudes) {
+    if (frame < 0 || frame >= numFrames || magnitudes.size() != static_cast<size_t>(numBins)) {
+      numBadFrames++;
+      return;
+    }
+    numCalls[frame]++;
+    std::copy(magnitudes.begin(), magnitudes.end(), rawFrames[frame].begin());
+  };
+  std::atomic<bool> isComplete{false};
+  fft.onProcessingComplete = [&](Utils::SpecBuffer&) { isComplete = true; };
+
+  fft.process(&audio);
+  REQUIRE(fft.waitForThreadToExit(THREAD_TIMEOUT_MS));
+  REQUIRE(isComplete);
+  REQUIRE(numBadFrames == 0);
+
+  const Utils::SpecBuffer& spectrum = fft.getSpectrum();
+  REQUIRE(spectrum.size() == static_cast<size_t>(numFrames));
+  for (int frame = 0; frame < numFrames; ++frame) {
+    CHECK(numCalls[frame] == 1);
+  }
+
+  // Frames are handed over before normalizing, the spectrum is the same values scaled by the loudest bin
+  const float maxValue = juce::FloatVectorOperations::findMaximum(rawFrames.data(), numFrames * numBins);
+  REQUIRE(maxValue > 0.0f);
+  for (int frame = 0; frame < numFrames; frame += numFrames / 8) {
+    for (int bin = 0; bin < numBins; bin += numBins / 8) {
+      CHECK_THAT(spectrum[frame][bin], WithinRel(rawFrames[frame][bin] / maxValue, 1e-5f));
+    }
+  }
+}
@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    GrainEventFifoTests.cpp
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <thread>
+
+#include "DSP/GrainEventFifo.h"
+
+static constexpr auto NUM_THREADED_EVENTS = 200000;
+
+namespace {
+// The index is carried in genIdx so the order can be checked
+GrainEvent makeEvent(int idx) {
+  return GrainEvent{Utils::PitchClass::C, idx, 0.1f, 1.0f, 0.5f, 0.1f, 1.0f, 0.0f, 0.0f};
+}
+}  // namespace
+
+TEST_CASE("GrainEventFifo drains events in order", "[grain events]") {
+  GrainEventFifo fifo;
+  CHECK(fifo.drain([](const GrainEvent&) {}) == 0);
+
+  // Batches that don't divide the capacity, so draining crosses the end of the buffer
+  int numPushed = 0;
+  int numDrained = 0;
+  bool isInOrder = true;
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < GrainEventFifo::CAPACITY / 3; ++i) fifo.push(makeEvent(numPushed++));
+    fifo.drain([&](const GrainEvent& event) { isInOrder &= event.genIdx == numDrained++; });
+  }
+  CHECK(isInOrder);
+  CHECK(numDrained == numPushed);
+  CHECK(fifo.getNumDropped() == 0);
+}
+
+TEST_CASE("GrainEventFifo drops events when full", "[grain events]") {
+  GrainEventFifo fifo;
+  const int numPushed = GrainEventFifo::CAPACITY * 2;
+  for (int i = 0; i < numPushed; ++i) fifo.push(makeEvent(i));
+
+  // What was already queued is kept, the newest events are the ones dropped
+  int numDrained = 0;
+  bool isInOrder = true;
+  fifo.drain([&](const GrainEvent& event) { isInOrder &= event.genIdx == numDrained++; });
+  CHECK(isInOrder);
+  CHECK(numDrained > 0);
+  CHECK(numDrained + fifo.getNumDropped() == numPushed);
+
+  fifo.push(makeEvent(-1));
+  CHECK(fifo.drain([](const GrainEvent& event) { CHECK(event.genIdx == -1); }) == 1);
+}
+
+TEST_CASE("GrainEventFifo with the audio thread and UI running at once", "[grain events]") {
+  GrainEventFifo fifo;
+  std::atomic<bool> isDone{false};
+  std::thread producer([&] {
+    for (int i = 0; i < NUM_THREADED_EVENTS; ++i) fifo.push(makeEvent(i));
+    isDone = true;
+  });
+
+  // Events can be dropped while the reader is behind, but never reordered or repeated
+  int numDrained = 0;
+  int lastIdx = -1;
+  bool isInOrder = true;
+  auto onEvent = [&](const GrainEvent& event) {
+    isInOrder &= event.genIdx > lastIdx;
+    lastIdx = event.genIdx;
+    numDrained++;
+  };
+  while (!isDone) fifo.drain(onEvent);
+  producer.join();
+  fifo.drain(onEvent);
+
+  CHECK(isInOrder);
+  CHECK(numDrained + fifo.getNumDropped() == NUM_THREADED_EVENTS);
+}
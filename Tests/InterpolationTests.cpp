@@ -0,0 +1,194 @@
+/*
+  ==============================================================================
+
+    InterpolationTests.cpp
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include "DSP/Grain.h"
+#include "DSP/Interpolation.h"
+
+using Catch::Matchers::WithinAbs;
+
+static constexpr auto FILE_SIZE = 4096;
+static constexpr auto ENV_SIZE = 129;  // With the durations below every envelope step is a power of two, so exact in a float
+static constexpr auto BLOCK_SIZE = 100;  // Not a multiple of the bank's chunk or register size
+static constexpr auto NUM_BLOCKS = 6;
+static constexpr Utils::InterpolationType ALL_INTERPOLATION[] = {
+    Utils::InterpolationType::LINEAR, Utils::InterpolationType::HERMITE, Utils::InterpolationType::SINC};
+
+namespace {
+std::vector<float> makeNoise(int numSamples, juce::Random& random) {
+  std::vector<float> noise(numSamples);
+  for (float& sample : noise) sample = random.nextFloat() * 2.0f - 1.0f;
+  return noise;
+}
+
+float interpolate(Utils::InterpolationType type, const Interpolation::WrappedReader& read, int idx, float t, int sincBand) {
+  switch (type) {
+    case Utils::InterpolationType::HERMITE:
+      return Interpolation::interpolate<Utils::InterpolationType::HERMITE>(read, idx, t, sincBand);
+    case Utils::InterpolationType::SINC:
+      return Interpolation::interpolate<Utils::InterpolationType::SINC>(read, idx, t, sincBand);
+    default:
+      return Interpolation::interpolate<Utils::InterpolationType::LINEAR>(read, idx, t, sincBand);
+  }
+}
+
+// Rates and envelope steps are exact in a float, so where each sample is read doesn't depend on how the phase is advanced
+typedef struct TestGrain {
+  float pbRate;
+  int startPos;
+  int duration;
+} TestGrain;
+const TestGrain TEST_GRAINS[] = {
+    {1.0f, 100, 256},
+    {0.5f, 2000, 512},
+    {1.25f, FILE_SIZE - 50, 256},  // Runs off the end and wraps to the start
+    {2.0f, 3, 128},                // Taps before the start of the file
+    {1.75f, 1000, 512},
+};
+}  // namespace
+
+TEST_CASE("Interpolation kernels pass through the samples", "[interpolation]") {
+  CHECK(Interpolation::lerp(0.25f, -0.5f, 0.0f) == 0.25f);
+  CHECK(Interpolation::lerp(0.25f, -0.5f, 1.0f) == -0.5f);
+  CHECK(Interpolation::hermite(0.9f, 0.25f, -0.5f, 0.3f, 0.0f) == 0.25f);
+  CHECK_THAT(Interpolation::hermite(0.9f, 0.25f, -0.5f, 0.3f, 1.0f), WithinAbs(-0.5f, 1e-6f));
+}
+
+TEST_CASE("Interpolation kernels follow a line", "[interpolation]") {
+  std::vector<float> line(64);
+  for (int i = 0; i < (int)line.size(); ++i) line[i] = 0.1f + 0.03f * i;
+  const Interpolation::DirectReader read{line.data()};
+  for (float t = 0.0f; t < 1.0f; t += 0.125f) {
+    const float expected = 0.1f + 0.03f * (32 + t);
+    CHECK_THAT(Interpolation::lerp(read(32), read(33), t), WithinAbs(expected, 1e-5f));
+    CHECK_THAT(Interpolation::hermite(read, 32, t), WithinAbs(expected, 1e-5f));
+  }
+}
+
+TEST_CASE("Sinc kernel keeps DC and low frequencies", "[interpolation]") {
+  std::vector<float> dc(64, 0.5f);
+  std::vector<float> sine(256);
+  const float omega = juce::MathConstants<float>::twoPi * 0.02f;
+  for (int i = 0; i < (int)sine.size(); ++i) sine[i] = std::sin(omega * i);
+  const Interpolation::DirectReader readDc{dc.data()};
+  const Interpolation::DirectReader readSine{sine.data()};
+
+  for (int band = 0; band < Interpolation::SincTable::NUM_BANDS; ++band) {
+    for (float t = 0.0f; t < 1.0f; t += 0.125f) {
+      CHECK_THAT(Interpolation::sinc(readDc, 32, t, band), WithinAbs(0.5f, 1e-5f));
+      // The phase of the table is rounded to 1 / NUM_PHASES of a sample
+      CHECK_THAT(Interpolation::sinc(readSine, 128, t, band), WithinAbs(std::sin(omega * (128 + t)), 5e-3f));
+    }
+  }
+}
+
+TEST_CASE("Sinc band follows the playback rate", "[interpolation]") {
+  CHECK(Interpolation::SincTable::getBand(0.5f) == 0);
+  CHECK(Interpolation::SincTable::getBand(1.0f) == 0);
+  CHECK(Interpolation::SincTable::getBand(1.2f) == 1);
+  CHECK(Interpolation::SincTable::getBand(1.5f) == 2);
+  CHECK(Interpolation::SincTable::getBand(2.0f) == 3);
+  CHECK(Interpolation::SincTable::getBand(4.0f) == 3);
+}
+
+TEST_CASE("WrappedReader loops the buffer", "[interpolation]") {
+  juce::Random random(1);
+  const std::vector<float> buffer = makeNoise(16, random);
+  const Interpolation::DirectReader direct{buffer.data()};
+  const Interpolation::WrappedReader wrapped{buffer.data(), (int)buffer.size()};
+  for (int i = 0; i < (int)buffer.size(); ++i) {
+    CHECK(wrapped(i) == direct(i));
+    CHECK(wrapped(i - 16) == direct(i));
+    CHECK(wrapped(i + 32) == direct(i));
+  }
+}
+
+TEST_CASE("GrainBank matches reading every sample on its own", "[interpolation]") {
+  juce::Random random(1);
+  juce::AudioBuffer<float> audio(2, FILE_SIZE);
+  for (int ch = 0; ch < 2; ++ch) {
+    const std::vector<float> noise = makeNoise(FILE_SIZE, random);
+    audio.copyFrom(ch, 0, noise.data(), FILE_SIZE);
+  }
+  std::vector<float> env(ENV_SIZE);
+  for (int i = 0; i < ENV_SIZE; ++i) env[i] = std::sin(juce::MathConstants<float>::pi * i / (ENV_SIZE - 1));
+  const int numSamples = BLOCK_SIZE * NUM_BLOCKS;
+
+  for (int numChannels = 1; numChannels <= 2; ++numChannels) {
+    juce::AudioBuffer<float> source(audio);
+    source.setSize(numChannels, FILE_SIZE, true);
+    for (Utils::InterpolationType type : ALL_INTERPOLATION) {
+      INFO("channels " << numChannels << " interpolation " << (int)type);
+      GrainBank bank;
+      for (const TestGrain& grain : TEST_GRAINS) {
+        bank.add(env.data(), ENV_SIZE, grain.duration, grain.pbRate, grain.startPos, FILE_SIZE, 0.0f);
+      }
+      juce::AudioBuffer<float> out(2, numSamples);
+      out.clear();
+      for (int start = 0; start < numSamples; start += BLOCK_SIZE) {
+        bank.process(source, out.getWritePointer(0, start), out.getWritePointer(1, start), BLOCK_SIZE, type);
+        bank.removeFinished();
+      }
+      CHECK(bank.size() == 0);
+
+      // Centered grains have unity gain on both sides, a mono source plays the same on both
+      std::vector<float> expected[2] = {std::vector<float>(numSamples, 0.0f), std::vector<float>(numSamples, 0.0f)};
+      for (int ch = 0; ch < 2; ++ch) {
+        const Interpolation::WrappedReader read{source.getReadPointer(juce::jmin(ch, numChannels - 1)), FILE_SIZE};
+        for (const TestGrain& grain : TEST_GRAINS) {
+          const float envInc = (ENV_SIZE - 1) / (float)grain.duration;
+          const int sincBand = Interpolation::SincTable::getBand(grain.pbRate);
+          for (int i = 0; i <= grain.duration && i < numSamples; ++i) {
+            const float phase = grain.pbRate * i;
+            const int offset = static_cast<int>(phase);
+            const float envValue = env[juce::jmin(ENV_SIZE - 1, static_cast<int>(envInc * i))];
+            expected[ch][i] += interpolate(type, read, grain.startPos + offset, phase - offset, sincBand) * envValue;
+          }
+        }
+        for (int i = 0; i < numSamples; ++i) {
+          CHECK_THAT(out.getSample(ch, i), WithinAbs(expected[ch][i], 1e-4f));
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("GrainBank starts a grain after its delay", "[interpolation]") {
+  juce::Random random(1);
+  const std::vector<float> noise = makeNoise(FILE_SIZE, random);
+  juce::AudioBuffer<float> source(1, FILE_SIZE);
+  source.copyFrom(0, 0, noise.data(), FILE_SIZE);
+  std::vector<float> env(ENV_SIZE, 1.0f);
+  const TestGrain& grain = TEST_GRAINS[0];
+  const int numSamples = BLOCK_SIZE * NUM_BLOCKS;
+
+  // Not on a register boundary and past the first block
+  for (int delay : {1, 37, BLOCK_SIZE + 3}) {
+    INFO("delay " << delay);
+    GrainBank onTime;
+    GrainBank delayed;
+    onTime.add(env.data(), ENV_SIZE, grain.duration, grain.pbRate, grain.startPos, FILE_SIZE, 0.0f);
+    delayed.add(env.data(), ENV_SIZE, grain.duration, grain.pbRate, grain.startPos, FILE_SIZE, 0.0f, delay);
+    juce::AudioBuffer<float> outOnTime(2, numSamples);
+    juce::AudioBuffer<float> outDelayed(2, numSamples);
+    outOnTime.clear();
+    outDelayed.clear();
+    for (int start = 0; start < numSamples; start += BLOCK_SIZE) {
+      onTime.process(source, outOnTime.getWritePointer(0, start), outOnTime.getWritePointer(1, start), BLOCK_SIZE,
+                     Utils::InterpolationType::HERMITE);
+      delayed.process(source, outDelayed.getWritePointer(0, start), outDelayed.getWritePointer(1, start), BLOCK_SIZE,
+                      Utils::InterpolationType::HERMITE);
+    }
+    for (int i = 0; i < numSamples; ++i) {
+      const float expected = (i < delay) ? 0.0f : outOnTime.getSample(0, i - delay);
+      CHECK(outDelayed.getSample(0, i) == expected);
+    }
+  }
+}
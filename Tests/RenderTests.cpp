@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+
+    RenderTests.cpp
+
+    Renders the same MIDI through the synth with different block sizes. Notes
+    and grains start on the sample they are due, so the output should not
+    depend on where the host splits the blocks.
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <juce_events/juce_events.h>
+
+#include "DSP/GranularSynth.h"
+
+using Catch::Matchers::WithinAbs;
+
+static constexpr auto SAMPLE_RATE = 48000.0;
+static constexpr auto AUDIO_SAMPLES = 48000;
+static constexpr auto RENDER_SAMPLES = 24000;  // Past the release of the last note
+static constexpr auto REFERENCE_BLOCK_SIZE = 512;
+static constexpr auto FIRST_NOTE_SAMPLE = 37;
+
+namespace {
+typedef struct TestEvent {
+  int sample;
+  int noteNumber;
+  bool isNoteOn;
+} TestEvent;
+// Odd offsets so events land inside blocks of every size below
+const TestEvent TEST_EVENTS[] = {
+    {FIRST_NOTE_SAMPLE, 60, true}, {1001, 64, true}, {4999, 67, true},   {6007, 60, false},
+    {7777, 64, false},             {8191, 71, true}, {12003, 67, false}, {12003, 71, false},
+};
+
+juce::AudioBuffer<float> makeTestAudio() {
+  juce::AudioBuffer<float> audio(2, AUDIO_SAMPLES);
+  for (int i = 0; i < AUDIO_SAMPLES; ++i) {
+    const double phase = juce::MathConstants<double>::twoPi * 220.0 * i / SAMPLE_RATE;
+    audio.setSample(0, i, 0.25f * static_cast<float>(std::sin(phase) + 0.5 * std::sin(2.0 * phase)));
+    audio.setSample(1, i, 0.25f * static_cast<float>(std::sin(phase) + 0.5 * std::sin(3.0 * phase)));
+  }
+  return audio;
+}
+
+juce::AudioBuffer<float> render(int blockSize) {
+  GranularSynth synth;
+  synth.setPlayConfigDetails(0, 2, SAMPLE_RATE, blockSize);
+  synth.prepareToPlay(SAMPLE_RATE, blockSize);
+  juce::AudioBuffer<float> audio = makeTestAudio();
+  synth.setInputBuffer(&audio, SAMPLE_RATE);
+  // Loaded like a preset so there is no analysis running, the candidates are set here instead
+  synth.processInput(juce::Range<juce::int64>(), true);
+  // The reset params have no spray, which is random, so every render plays the same grains
+  synth.resetParameters();
+  for (auto& note : synth.getParamsNote().notes) {
+    for (int i = 0; i < NUM_GENERATORS; ++i) {
+      note->candidates.push_back(ParamCandidate((i + 0.5f) / NUM_GENERATORS, 1.0f, 0.1f, 1.0f));
+    }
+    for (auto& gen : note->generators) {
+      ParamHelper::setParam(gen->candidate, gen->genIdx);
+    }
+  }
+  synth.publishCandidates();
+
+  juce::AudioBuffer<float> out(2, RENDER_SAMPLES);
+  juce::AudioBuffer<float> buffer(2, blockSize);
+  juce::MidiBuffer midi;
+  for (int start = 0; start < RENDER_SAMPLES; start += blockSize) {
+    const int numSamples = juce::jmin(blockSize, RENDER_SAMPLES - start);
+    buffer.setSize(2, numSamples, false, false, true);
+    buffer.clear();
+    midi.clear();
+    for (const TestEvent& event : TEST_EVENTS) {
+      if (event.sample < start || event.sample >= start + numSamples) continue;
+      const juce::MidiMessage message = event.isNoteOn ? juce::MidiMessage::noteOn(1, event.noteNumber, 1.0f)
+                                                       : juce::MidiMessage::noteOff(1, event.noteNumber);
+      midi.addEvent(message, event.sample - start);
+    }
+    synth.processBlock(buffer, midi);
+    for (int ch = 0; ch < 2; ++ch) out.copyFrom(ch, start, buffer, ch, 0, numSamples);
+  }
+  return out;
+}
+}  // namespace
+
+TEST_CASE("Rendering doesn't depend on the block size", "[render]") {
+  juce::ScopedJuceInitialiser_GUI juceInitialiser;  // The parameters need a message manager
+  const juce::AudioBuffer<float> reference = render(REFERENCE_BLOCK_SIZE);
+
+  // Silent until the first note, then actually playing
+  for (int i = 0; i < FIRST_NOTE_SAMPLE; ++i) {
+    REQUIRE(reference.getSample(0, i) == 0.0f);
+  }
+  REQUIRE(reference.getMagnitude(FIRST_NOTE_SAMPLE, RENDER_SAMPLES - FIRST_NOTE_SAMPLE) > 0.01f);
+
+  for (int blockSize : {1, 7, 64, 100, 333, 2048}) {
+    INFO("block size " << blockSize);
+    const juce::AudioBuffer<float> output = render(blockSize);
+    // Only the worst sample is checked, a shifted note would fail on thousands of them
+    int worstCh = 0;
+    int worstIdx = 0;
+    float worstDiff = 0.0f;
+    for (int ch = 0; ch < 2; ++ch) {
+      for (int i = 0; i < RENDER_SAMPLES; ++i) {
+        const float diff = std::abs(output.getSample(ch, i) - reference.getSample(ch, i));
+        if (diff > worstDiff) {
+          worstCh = ch;
+          worstIdx = i;
+          worstDiff = diff;
+        }
+      }
+    }
+    INFO("channel " << worstCh << " sample " << worstIdx);
+    CHECK_THAT(output.getSample(worstCh, worstIdx), WithinAbs(reference.getSample(worstCh, worstIdx), 1e-4f));
+  }
+}
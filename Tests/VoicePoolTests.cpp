@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    VoicePoolTests.cpp
+
+    Voices are only seen through the block stats, no audio is loaded so the
+    voices start and stop without playing any grains.
+
+  ==============================================================================
+*/
+
+#include <catch2/catch_test_macros.hpp>
+#include <juce_events/juce_events.h>
+
+#include "DSP/GranularSynth.h"
+
+static constexpr auto SAMPLE_RATE = 48000.0;
+static constexpr auto BLOCK_SIZE = 256;
+static constexpr auto RELEASE_SEC = 0.01f;  // Shortest release, so released voices are freed quickly
+static constexpr auto SETTLE_SEC = 0.1;     // Past the release and the fade of a stolen voice
+static constexpr auto NOTE_C = 60;
+static constexpr auto NOTE_D = 62;
+static constexpr auto NOTE_E = 64;
+
+namespace {
+struct TestSynth {
+  TestSynth(int polyphony, ParamGlobal::VoiceSteal voiceSteal) {
+    synth.setPlayConfigDetails(0, 2, SAMPLE_RATE, BLOCK_SIZE);
+    synth.prepareToPlay(SAMPLE_RATE, BLOCK_SIZE);
+    ParamGlobal& global = synth.getParamGlobal();
+    ParamHelper::setParam(global.polyphony, polyphony);
+    ParamHelper::setParam(global.voiceSteal, (int)voiceSteal);
+    ParamHelper::setParam(P_FLOAT(global.common[ParamCommon::Type::RELEASE]), RELEASE_SEC);
+  }
+
+  // Sent with the next block
+  void noteOn(int noteNumber, float velocity = 1.0f) { midi.addEvent(juce::MidiMessage::noteOn(1, noteNumber, velocity), 0); }
+  void noteOff(int noteNumber) { midi.addEvent(juce::MidiMessage::noteOff(1, noteNumber), 0); }
+
+  // Renders whole blocks for at least sec, returns the voices active after the last one
+  int render(double sec) {
+    BlockStats::Summary summary;
+    const int numBlocks = juce::jmax(1, static_cast<int>(std::ceil(sec * SAMPLE_RATE / BLOCK_SIZE)));
+    for (int i = 0; i < numBlocks; ++i) {
+      synth.processBlock(buffer, midi);
+      midi.clear();
+      synth.getBlockStats().drain(summary);
+    }
+    return summary.activeVoices;
+  }
+
+  juce::ScopedJuceInitialiser_GUI juceInitialiser;  // The parameters need a message manager
+  GranularSynth synth;
+  juce::AudioBuffer<float> buffer{2, BLOCK_SIZE};
+  juce::MidiBuffer midi;
+};
+}  // namespace
+
+TEST_CASE("Voice pool stops at the polyphony", "[voices]") {
+  TestSynth test(3, ParamGlobal::VoiceSteal::OLDEST);
+  for (int i = 0; i < 5; ++i) test.noteOn(NOTE_C + i);
+  CHECK(test.render(SETTLE_SEC) == 3);
+  // Every note is still held, some of them only on a stolen voice
+  CHECK(test.synth.getMidiNotes().size() == 5);
+
+  for (int i = 0; i < 5; ++i) test.noteOff(NOTE_C + i);
+  CHECK(test.render(SETTLE_SEC) == 0);
+  CHECK(test.synth.getMidiNotes().isEmpty());
+}
+
+TEST_CASE("Voice pool steals the oldest voice", "[voices]") {
+  TestSynth test(2, ParamGlobal::VoiceSteal::OLDEST);
+  test.noteOn(NOTE_C);
+  test.render(SETTLE_SEC);
+  test.noteOn(NOTE_D);
+  test.render(SETTLE_SEC);
+  test.noteOn(NOTE_E);
+  CHECK(test.render(SETTLE_SEC) == 2);
+
+  // C lost its voice to E, so releasing it frees nothing
+  test.noteOff(NOTE_C);
+  CHECK(test.render(SETTLE_SEC) == 2);
+  test.noteOff(NOTE_D);
+  CHECK(test.render(SETTLE_SEC) == 1);
+  test.noteOff(NOTE_E);
+  CHECK(test.render(SETTLE_SEC) == 0);
+}
+
+TEST_CASE("Voice pool steals the quietest voice", "[voices]") {
+  TestSynth test(2, ParamGlobal::VoiceSteal::QUIETEST);
+  test.noteOn(NOTE_C, 1.0f);
+  test.noteOn(NOTE_D, 0.2f);
+  // Past the attack, both are at their sustain level
+  test.render(ParamDefaults::ATTACK_DEFAULT_SEC + SETTLE_SEC);
+  test.noteOn(NOTE_E);
+  CHECK(test.render(SETTLE_SEC) == 2);
+
+  // D is younger than C but quieter, it lost its voice to E
+  test.noteOff(NOTE_D);
+  CHECK(test.render(SETTLE_SEC) == 2);
+  test.noteOff(NOTE_C);
+  CHECK(test.render(SETTLE_SEC) == 1);
+}
+
+TEST_CASE("Voice pool steals released voices first", "[voices]") {
+  TestSynth test(2, ParamGlobal::VoiceSteal::OLDEST);
+  test.noteOn(NOTE_C);
+  test.render(SETTLE_SEC);
+  test.noteOn(NOTE_D);
+  test.render(SETTLE_SEC);
+  // D is still in its release when E comes in and takes it over, even though C is older
+  test.noteOff(NOTE_D);
+  test.noteOn(NOTE_E);
+  CHECK(test.render(SETTLE_SEC) == 2);
+  test.noteOff(NOTE_E);
+  CHECK(test.render(SETTLE_SEC) == 1);
+}
+
+TEST_CASE("Voice pool drops a note released before its stolen voice is free", "[voices]") {
+  TestSynth test(1, ParamGlobal::VoiceSteal::OLDEST);
+  test.noteOn(NOTE_C);
+  test.render(SETTLE_SEC);
+  // C fades out for D, but D is gone before that is done so the voice is just freed
+  test.noteOn(NOTE_D);
+  test.noteOff(NOTE_D);
+  CHECK(test.render(SETTLE_SEC) == 0);
+}
@@ -0,0 +1,196 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    Headless renderer, plays a MIDI file through the synth faster than realtime
+    and writes the result to a wav file. Used for batch rendering and for
+    reproducible performance runs without a DAW.
+
+  ==============================================================================
+*/
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_events/juce_events.h>
+
+#include "DSP/GranularSynth.h"
+
+static constexpr auto DEFAULT_SAMPLE_RATE = 48000.0;
+static constexpr auto DEFAULT_BLOCK_SIZE = 512;
+static constexpr auto DEFAULT_TAIL_SEC = 2.0;  // Lets the longest release finish after the last midi event
+static constexpr auto ANALYSIS_TIMEOUT_MS = 5 * 60 * 1000;
+
+static void printUsage() {
+  std::cout << "Usage: gRainbowRender --midi <file.mid> --output <file.wav> [--audio <file>] [--preset <file.gbow>]\n"
+               "                      [--sample-rate <hz>] [--block-size <samples>] [--tail <seconds>] [--whiten]\n"
+               "                      [--segments <n>] [--no-cache]\n\n"
+               "  Values can be given as --option value or --option=value\n\n"
+               "  --audio   audio file to analyze and play grains from\n"
+               "  --preset  .gbow preset, used on its own it provides the audio and all params. Combined with\n"
+               "            --audio only its knob values are applied after the audio is analyzed\n"
+               "  --tail    seconds to keep rendering after the last midi event (default 2)\n"
+               "  --whiten  whiten the spectrum of --audio before pitch detection\n"
+               "  --segments  pitches of --audio tracked at once, 1 (default) follows a single melody\n"
+               "  --no-cache  always analyze --audio instead of reusing the analysis from an earlier load\n";
+}
+
+// Takes both --option=value and --option value, juce::ArgumentList only knows the first for long options
+static juce::String getOption(const juce::ArgumentList& args, const juce::String& option) {
+  const int index = args.indexOfOption(option);
+  if (index < 0) return {};
+  const juce::String value = args.getValueForOption(option);
+  if (value.isNotEmpty()) return value;
+  if (index + 1 < args.size() && !args[index + 1].isOption()) return args[index + 1].text;
+  return {};
+}
+
+// Relative paths are from the working directory, sets errorMessage if there is no such file
+static juce::File getExistingFile(const juce::String& path, juce::String& errorMessage) {
+  const juce::File file = juce::File::getCurrentWorkingDirectory().getChildFile(path);
+  if (!file.existsAsFile()) errorMessage = "No such file " + file.getFullPathName();
+  return file;
+}
+
+// Merges all tracks of the midi file into a single sequence with timestamps in seconds
+static juce::MidiMessageSequence loadMidi(const juce::File& file, juce::String& errorMessage) {
+  juce::MidiMessageSequence sequence;
+  juce::FileInputStream input(file);
+  juce::MidiFile midiFile;
+  if (!input.openedOk() || !midiFile.readFrom(input)) {
+    errorMessage = "Unable to read the midi file " + file.getFullPathName();
+    return sequence;
+  }
+  midiFile.convertTimestampTicksToSeconds();
+  for (int i = 0; i < midiFile.getNumTracks(); ++i) {
+    sequence.addSequence(*midiFile.getTrack(i), 0.0);
+  }
+  sequence.updateMatchedPairs();
+  return sequence;
+}
+
+static void loadAudio(GranularSynth& synth, const juce::File& file, juce::String& errorMessage) {
+  juce::AudioFormatManager formatManager;
+  formatManager.registerBasicFormats();
+  std::unique_ptr<juce::AudioFormatReader> formatReader(formatManager.createReaderFor(file));
+  if (formatReader == nullptr) {
+    errorMessage = "Unable to read the audio file " + file.getFullPathName();
+    return;
+  }
+
+  juce::AudioBuffer<float> fileAudioBuffer(formatReader->numChannels, static_cast<int>(formatReader->lengthInSamples));
+  formatReader->read(&fileAudioBuffer, 0, fileAudioBuffer.getNumSamples(), 0, true, true);
+  synth.setInputBuffer(&fileAudioBuffer, formatReader->sampleRate);
+  synth.processInput(juce::Range<juce::int64>(), false);
+
+  // Analysis runs on its own threads
+  const juce::uint32 startMs = juce::Time::getMillisecondCounter();
+  while (synth.getLoadingProgress() < 1.0) {
+    if (juce::Time::getMillisecondCounter() - startMs > ANALYSIS_TIMEOUT_MS) {
+      errorMessage = "Timed out analyzing " + file.getFullPathName();
+      return;
+    }
+    juce::Thread::sleep(10);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  // The parameters rely on the message manager existing
+  juce::ScopedJuceInitialiser_GUI juceInitialiser;
+  juce::ArgumentList args(argc, argv);
+
+  const juce::String midiPath = getOption(args, "--midi");
+  const juce::String outputPath = getOption(args, "--output");
+  const juce::String audioPath = getOption(args, "--audio");
+  const juce::String presetPath = getOption(args, "--preset");
+  if (args.containsOption("--help|-h") || midiPath.isEmpty() || outputPath.isEmpty() ||
+      (audioPath.isEmpty() && presetPath.isEmpty())) {
+    printUsage();
+    return 1;
+  }
+
+  const double sampleRate = args.containsOption("--sample-rate") ? getOption(args, "--sample-rate").getDoubleValue()
+                                                                  : DEFAULT_SAMPLE_RATE;
+  const int blockSize =
+      args.containsOption("--block-size") ? getOption(args, "--block-size").getIntValue() : DEFAULT_BLOCK_SIZE;
+  const double tailSec = args.containsOption("--tail") ? getOption(args, "--tail").getDoubleValue() : DEFAULT_TAIL_SEC;
+  if (sampleRate <= 0.0 || blockSize <= 0 || tailSec < 0.0) {
+    std::cerr << "Invalid sample rate, block size or tail\n";
+    return 1;
+  }
+
+  juce::String errorMessage;
+  const juce::File midiFile = getExistingFile(midiPath, errorMessage);
+  juce::MidiMessageSequence sequence;
+  if (errorMessage.isEmpty()) sequence = loadMidi(midiFile, errorMessage);
+  if (errorMessage.isNotEmpty()) {
+    std::cerr << errorMessage << "\n";
+    return 1;
+  }
+
+  GranularSynth synth;
+  const int numChannels = synth.getTotalNumOutputChannels();
+  synth.setPlayConfigDetails(0, numChannels, sampleRate, blockSize);
+  synth.prepareToPlay(sampleRate, blockSize);
+
+  if (audioPath.isNotEmpty()) {
+    synth.setSpectralWhitening(args.containsOption("--whiten"));
+    synth.setUseAnalysisCache(!args.containsOption("--no-cache"));
+    if (args.containsOption("--segments")) synth.setNumPitchSegments(getOption(args, "--segments").getIntValue());
+    const juce::File audioFile = getExistingFile(audioPath, errorMessage);
+    if (errorMessage.isEmpty()) loadAudio(synth, audioFile, errorMessage);
+  }
+  if (errorMessage.isEmpty() && presetPath.isNotEmpty()) {
+    const juce::File presetFile = getExistingFile(presetPath, errorMessage);
+    if (errorMessage.isEmpty()) synth.loadPreset(presetFile, errorMessage, audioPath.isNotEmpty());
+  }
+  if (errorMessage.isNotEmpty()) {
+    std::cerr << errorMessage << "\n";
+    return 1;
+  }
+
+  const juce::File outputFile = juce::File::getCurrentWorkingDirectory().getChildFile(outputPath);
+  outputFile.deleteFile();
+  std::unique_ptr<juce::FileOutputStream> outputStream = outputFile.createOutputStream();
+  juce::WavAudioFormat wavFormat;
+  std::unique_ptr<juce::AudioFormatWriter> writer(
+      outputStream == nullptr ? nullptr : wavFormat.createWriterFor(outputStream.get(), sampleRate, numChannels, 24, {}, 0));
+  if (writer == nullptr) {
+    std::cerr << "Unable to open " << outputFile.getFullPathName() << " to write\n";
+    return 1;
+  }
+  outputStream.release();  // writer owns the stream now
+
+  const juce::int64 totalSamples = static_cast<juce::int64>((sequence.getEndTime() + tailSec) * sampleRate);
+  juce::AudioBuffer<float> buffer(numChannels, blockSize);
+  juce::MidiBuffer midiBuffer;
+  int nextEvent = 0;
+
+  const double startSec = juce::Time::getMillisecondCounterHiRes() / 1000.0;
+  for (juce::int64 blockStart = 0; blockStart < totalSamples; blockStart += blockSize) {
+    const int numSamples = static_cast<int>(juce::jmin((juce::int64)blockSize, totalSamples - blockStart));
+    buffer.setSize(numChannels, numSamples, false, false, true);
+    buffer.clear();
+
+    // Hand over every event that lands in this block at its offset
+    midiBuffer.clear();
+    const juce::int64 blockEnd = blockStart + numSamples;
+    for (; nextEvent < sequence.getNumEvents(); ++nextEvent) {
+      const juce::MidiMessage& message = sequence.getEventPointer(nextEvent)->message;
+      const juce::int64 eventSample = static_cast<juce::int64>(message.getTimeStamp() * sampleRate);
+      if (eventSample >= blockEnd) break;
+      midiBuffer.addEvent(message, static_cast<int>(juce::jmax((juce::int64)0, eventSample - blockStart)));
+    }
+
+    synth.processBlock(buffer, midiBuffer);
+    writer->writeFromAudioSampleBuffer(buffer, 0, numSamples);
+  }
+  const double renderSec = juce::Time::getMillisecondCounterHiRes() / 1000.0 - startSec;
+  const double audioSec = totalSamples / sampleRate;
+
+  synth.releaseResources();
+  std::cout << juce::String::formatted("Rendered %.2fs of audio in %.3fs (%.1fx realtime, %.1f ns/sample) to ", audioSec,
+                                       renderSec, audioSec / juce::jmax(renderSec, 1e-9),
+                                       (renderSec * 1e9) / juce::jmax((juce::int64)1, totalSamples))
+            << outputFile.getFullPathName() << "\n";
+  return 0;
+}